@@ -0,0 +1,114 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#ifndef NO_STD_EXECUTION
+    #include <execution>
+#endif // NO_STD_EXECUTION
+
+#include <Solar-Collector-Shape-Optimiser/acceptancemap.hpp>
+
+// upper bound on the size of the bitmaps
+static constexpr uint64_t MAX_WORDS = uint64_t(1) << 28; // 2 GiB
+
+AcceptanceMap::AcceptanceMap(const Mesh3d& obstacle, const uint32_t xsize, const uint32_t ysize, const uint32_t hmax,
+                             const double cell_size, const uint32_t layers, const uint32_t resolution)
+    : cell_size(cell_size)
+    , layer_height(double(hmax) / layers)
+    , xcells(0)
+    , zcells(0)
+    , layers(layers)
+    , resolution(resolution)
+    , words((uint64_t(resolution) * resolution + 63) / 64)
+    , bits()
+{
+    if (!(cell_size > 0.0) || layers == 0 || resolution == 0) {
+        throw std::runtime_error("AcceptanceMap needs a positive cell size, number of layers and resolution");
+    }
+    if (resolution > ACCEPTANCE_MAX_RESOLUTION) {
+        throw std::runtime_error("AcceptanceMap resolution can't be greater than " + std::to_string(ACCEPTANCE_MAX_RESOLUTION) 
+                                 + ", got " + std::to_string(resolution));
+    }
+
+    // grid of the collector spans [0, xsize-1] x [0, ysize-1], heights [0, hmax]
+    xcells = std::max(1u, uint32_t(std::ceil((xsize - 1) / cell_size)));
+    zcells = std::max(1u, uint32_t(std::ceil((ysize - 1) / cell_size)));
+
+    const uint64_t samples = uint64_t(xcells) * zcells * layers;
+    if (samples * words > MAX_WORDS) {
+        throw std::runtime_error("AcceptanceMap would need " + std::to_string(samples * words * 8) + " bytes, use larger cells or a lower resolution");
+    }
+    bits.assign(samples * words, 0);
+
+    // every cell traces its own bitmap (no shared writes)
+    auto traceSample = [&](const uint32_t s) {
+        const uint32_t cx = s % xcells;
+        const uint32_t cz = (s / xcells) % zcells;
+        const uint32_t k = s / xcells / zcells;
+
+        const double x = (cx + 0.5) * cell_size;
+        const double y = (k + 0.5) * layer_height;
+        const double z = (cz + 0.5) * cell_size;
+
+        uint64_t* bitmap = bits.data() + size_t(s) * words;
+        for (uint32_t t = 0; t < resolution * resolution; ++t) {
+            if (obstacle.rayHit(x, y, z, direction(t))) {
+                bitmap[t / 64] |= uint64_t(1) << (t % 64);
+            }
+        }
+    };
+
+    #ifndef NO_STD_EXECUTION
+        std::vector<uint32_t> sample_ids(samples);
+        std::iota(sample_ids.begin(), sample_ids.end(), 0u);
+        std::for_each(std::execution::par, sample_ids.begin(), sample_ids.end(), traceSample);
+    #else
+        #pragma omp parallel for schedule(dynamic)
+        for (uint32_t s = 0; s < samples; ++s) {
+            traceSample(s);
+        }
+    #endif // NO_STD_EXECUTION
+}
+
+AcceptanceMap::~AcceptanceMap() {}
+
+size_t AcceptanceMap::sample(const double x, const double y, const double z) const {
+    // points outside of the grid (ex. circumcentres of steep triangles) use the nearest cell
+    const uint32_t cx = uint32_t(std::clamp(x / cell_size, 0.0, xcells - 1.0));
+    const uint32_t cz = uint32_t(std::clamp(z / cell_size, 0.0, zcells - 1.0));
+    const uint32_t k = uint32_t(std::clamp(y / layer_height, 0.0, layers - 1.0));
+    return (size_t(k) * zcells + cz) * xcells + cx;
+}
+
+// octahedral mapping: the L1-normalised direction is folded onto the square [-1, 1]^2 (lower hemisphere into the corners)
+uint32_t AcceptanceMap::texel(const double dx, const double dy, const double dz) const {
+    const double norm = std::abs(dx) + std::abs(dy) + std::abs(dz);
+    double u = dx / norm;
+    double v = dz / norm;
+    if (dy < 0.0) {
+        const double fu = (1.0 - std::abs(v)) * (u >= 0.0 ? 1.0 : -1.0);
+        const double fv = (1.0 - std::abs(u)) * (v >= 0.0 ? 1.0 : -1.0);
+        u = fu;
+        v = fv;
+    }
+    const uint32_t i = std::min(resolution - 1, uint32_t((u + 1.0) * 0.5 * resolution));
+    const uint32_t j = std::min(resolution - 1, uint32_t((v + 1.0) * 0.5 * resolution));
+    return j * resolution + i;
+}
+
+// direction through the centre of a texel (inverse of `texel`)
+vertex AcceptanceMap::direction(const uint32_t texel) const {
+    const double u = ((texel % resolution) + 0.5) / resolution * 2.0 - 1.0;
+    const double v = ((texel / resolution) + 0.5) / resolution * 2.0 - 1.0;
+    const double dy = 1.0 - std::abs(u) - std::abs(v);
+    if (dy < 0.0) {
+        return vertex((1.0 - std::abs(v)) * (u >= 0.0 ? 1.0 : -1.0), dy, (1.0 - std::abs(u)) * (v >= 0.0 ? 1.0 : -1.0));
+    }
+    return vertex(u, dy, v);
+}
+
+bool AcceptanceMap::accepts(const double x, const double y, const double z, const double dx, const double dy, const double dz) const {
+    const uint32_t t = texel(dx, dy, dz);
+    return (bits[sample(x, y, z) * words + t / 64] >> (t % 64)) & 1;
+}
@@ -0,0 +1,43 @@
+#ifndef ACCEPTANCEMAP_HPP
+#define ACCEPTANCEMAP_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <Solar-Collector-Shape-Optimiser/mesh3d.hpp>
+
+// upper bound on the resolution of the bitmaps (texel indices are 32-bit; a bitmap of 4096^2 texels is 2 MiB per cell)
+constexpr uint32_t ACCEPTANCE_MAX_RESOLUTION = 4096;
+
+// precomputed answer to "does a ray leaving (x, y, z) in direction d hit the obstacle?" (the reflected-ray test in
+// computeFitness), built once from the obstacle - independent of the individuals and of the rays
+//
+// the volume the collector can occupy is split into cells of cell_size x cell_size (x, z) and `layers` heights; for the
+// centre of every cell a bitmap of resolution x resolution directions (octahedral mapping of the unit sphere) records
+// which of them hit the obstacle
+// a lookup snaps the point to its cell and the direction to its texel, so the result is an approximation - finer
+// cells, more layers and a higher resolution trade memory and start-up time for accuracy
+class AcceptanceMap {
+public:
+    AcceptanceMap(const Mesh3d& obstacle, const uint32_t xsize, const uint32_t ysize, const uint32_t hmax,
+                  const double cell_size = 4.0, const uint32_t layers = 16, const uint32_t resolution = 32);
+    // copy, move constructors, assignments can be default
+    ~AcceptanceMap();
+
+    bool accepts(const double x, const double y, const double z, const double dx, const double dy, const double dz) const;
+
+private:
+    double cell_size;    // size of a cell along x and z
+    double layer_height; // size of a cell along y
+    uint32_t xcells, zcells, layers;
+    uint32_t resolution; // number of texels along each side of a bitmap
+    uint32_t words;      // number of 64-bit words of a bitmap
+
+    std::vector<uint64_t> bits; // bitmap of every cell, layer after layer, row (z) after row, cell (x) after cell
+
+    size_t sample(const double x, const double y, const double z) const;
+    uint32_t texel(const double dx, const double dy, const double dz) const;
+    vertex direction(const uint32_t texel) const;
+};
+
+#endif // ACCEPTANCEMAP_HPP
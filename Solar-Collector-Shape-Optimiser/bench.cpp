@@ -0,0 +1,228 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <filesystem>
+
+#include <Solar-Collector-Shape-Optimiser/solarcollector.hpp>
+#include <Solar-Collector-Shape-Optimiser/mesharena.hpp>
+#include <Solar-Collector-Shape-Optimiser/shadowtable.hpp>
+#include <Solar-Collector-Shape-Optimiser/checkpoint.hpp>
+#include <Solar-Collector-Shape-Optimiser/rng.hpp>
+#include <Solar-Collector-Shape-Optimiser/hash.hpp>
+#include <Solar-Collector-Shape-Optimiser/stats.hpp>
+
+// Benchmarks of the hot paths on fixed seeds and grid sizes: prints a summary to stderr and the results as JSON to
+// stdout (see the 'bench' target of the Makefile). Results that don't depend on timing are checked against golden
+// values; the exit code is 1 if any of them differs. Every benchmark is a Stats phase, so hardware counters (if the
+// kernel allows them) show whether it is compute, memory or branch bound.
+// Usage: solar_bench [obstacle STL, default ./obstacleBin.stl] [raw vector instruction event, see PerfCounters]
+
+// golden values hold for the default build (double geometry and genes) and the obstacleBin.stl of the repository
+#if !defined(SINGLE_PRECISION_GEOMETRY) && !defined(QUANTISED_GENES)
+    #define BENCH_GOLDEN 1
+#else
+    #define BENCH_GOLDEN 0
+#endif
+
+constexpr uint32_t BENCH_XSIZE = 181;
+constexpr uint32_t BENCH_YSIZE = 941;
+constexpr uint32_t BENCH_HMAX = 181;
+constexpr uint64_t BENCH_SEED = 42;
+constexpr uint32_t BENCH_RAYS = 1 << 16; // rays of the rayObstacleHit benchmark
+
+struct bench_result {
+    std::string name;
+    std::string unit;            // what `work` counts
+    double work;                 // units processed by one run
+    std::vector<double> seconds; // duration of every run
+    bool has_golden;
+    double expected;
+    double actual;
+};
+
+// runs `fn` once to warm up, then `runs` times timed
+static bench_result measure(const std::string& name, const std::string& unit, const double work, const uint32_t runs, const std::function<void()>& fn) {
+    bench_result result{name, unit, work, {}, false, 0.0, 0.0};
+    fn();
+    const stat_id phase = Stats::timer(name);
+    for (uint32_t r = 0; r < runs; ++r) {
+        Stats::begin(phase);
+        const auto start = std::chrono::steady_clock::now();
+        fn();
+        result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        Stats::end(phase);
+    }
+    return result;
+}
+
+static void golden(bench_result& result, const double expected, const double actual) {
+    result.has_golden = BENCH_GOLDEN;
+    result.expected = expected;
+    result.actual = actual;
+}
+
+// heights of a rough, reproducible collector (uniform in [0, scale))
+static void randomShape(SolarCollector& sc, const double scale, const uint64_t stream) {
+    RngStream rng(BENCH_SEED, stream);
+    for (uint32_t y = 0; y < sc.ysize; y++) {
+        for (uint32_t x = 0; x < sc.xsize; x++) {
+            sc.setXY(x, y, rng.uniform() * scale);
+        }
+    }
+    sc.computeMesh();
+}
+
+int main(int argc, char** argv) {
+    const std::string obstacle_file = argc > 1 ? argv[1] : "./obstacleBin.stl";
+    Stats::enablePerfCounters(argc > 2 ? std::stoull(argv[2], nullptr, 0) : 0);
+    const std::string temp_dir = (std::filesystem::temp_directory_path() / "solar_bench").string();
+    std::filesystem::create_directories(temp_dir);
+
+    const Mesh3d obs(obstacle_file, (BENCH_XSIZE-1.0)/2.0, (BENCH_HMAX-1.0)/2.0);
+    const std::vector<vertex> rays{{0, -1, 0}, {0.2, -1, 0.1}};
+    const uint32_t triangle_count = (BENCH_XSIZE-1)*(BENCH_YSIZE-1)*2;
+    const ShadowTable shadows(obs, rays);
+
+    MeshArena arena(1, triangle_count);
+    SolarCollector arena_collector(BENCH_XSIZE, BENCH_YSIZE, BENCH_HMAX, &obs, arena.slot(0));
+    SolarCollector collector(BENCH_XSIZE, BENCH_YSIZE, BENCH_HMAX, &obs);
+    randomShape(arena_collector, 20.0, 0);
+    randomShape(collector, 20.0, 0);
+
+    std::vector<bench_result> results;
+
+    // any-hit tests of single rays against the obstacle's BVH, from points of the collector's volume in random directions
+    {
+        std::vector<vertex> sources(BENCH_RAYS), directions(BENCH_RAYS);
+        RngStream rng(BENCH_SEED, 1);
+        for (uint32_t i = 0; i < BENCH_RAYS; ++i) {
+            sources[i] = vertex(rng.uniform() * (BENCH_XSIZE-1), rng.uniform() * (BENCH_HMAX-1) / 2.0, rng.uniform() * (BENCH_YSIZE-1));
+            const double z = rng.uniform();            // upwards
+            const double phi = rng.uniform() * 2.0 * M_PI;
+            const double r = std::sqrt(1.0 - z * z);
+            directions[i] = vertex(r * std::cos(phi), z, r * std::sin(phi));
+        }
+        uint32_t hits = 0;
+        results.push_back(measure("rayObstacleHit", "ray", BENCH_RAYS, 10, [&]() {
+            hits = 0;
+            for (uint32_t i = 0; i < BENCH_RAYS; ++i) {
+                hits += collector.rayObstacleHit(sources[i].x, sources[i].y, sources[i].z, directions[i], false);
+            }
+        }));
+        golden(results.back(), 7057, hits);
+    }
+
+    // normals and circumcentres of the whole mesh into a MeshArena slot
+    results.push_back(measure("computeMesh", "triangle", triangle_count, 10, [&]() { arena_collector.computeMesh(); }));
+
+    // fitness with geometry derived on the fly (heightmap) or precomputed (arena), with or without the ShadowTable
+    {
+        double fitness = 0.0;
+        auto fitnessBench = [&](const std::string& name, SolarCollector& sc, const ShadowTable* table) {
+            results.push_back(measure(name, "ray", double(triangle_count) * rays.size(), 5, [&]() {
+                sc.computeFitness(rays, table);
+                fitness = sc.fitness;
+            }));
+            golden(results.back(), 212, fitness);
+        };
+        fitnessBench("computeFitness/heightmap", collector, nullptr);
+        fitnessBench("computeFitness/heightmap+shadowtable", collector, &shadows);
+        fitnessBench("computeFitness/arena+shadowtable", arena_collector, &shadows);
+    }
+
+    // crossover and mutation of a whole genome
+    {
+        SolarCollector parent1(BENCH_XSIZE, BENCH_YSIZE, BENCH_HMAX, &obs);
+        SolarCollector parent2(BENCH_XSIZE, BENCH_YSIZE, BENCH_HMAX, &obs);
+        randomShape(parent1, 20.0, 2);
+        randomShape(parent2, 20.0, 3);
+
+        // what the Genome(parent1, parent2) constructor does (allocation + breed), on a fixed stream instead of threadRng
+        results.push_back(measure("Genome(parent1, parent2)", "gene", parent1.dna_size, 10, [&]() {
+            RngStream rng(BENCH_SEED, 5);
+            Genome offspring(parent1.dna_size, parent1.dna_min, parent1.dna_max, parent1.dna_resolution);
+            offspring.breed(parent1, parent2, 0.6, 0.05, 0.225, rng);
+        }));
+
+        Genome offspring(parent1.dna_size, parent1.dna_min, parent1.dna_max, parent1.dna_resolution);
+        results.push_back(measure("Genome::breed", "gene", parent1.dna_size, 10, [&]() {
+            RngStream rng(BENCH_SEED, 4);
+            offspring.breed(parent1, parent2, 0.6, 0.05, 0.225, rng);
+        }));
+        // the offspring's dna, reduced to a number (exact in a double)
+        golden(results.back(), 1608682835, double(offspring.hashDNA() >> 32));
+    }
+
+    // STL round trip of the collector's mesh
+    {
+        const std::string stl_file = temp_dir + "/collector.stl";
+        const Mesh3d mesh = collector.buildMesh();
+        results.push_back(measure("exportBinarySTL", "triangle", triangle_count, 5, [&]() { mesh.exportBinarySTL(stl_file); }));
+        uint32_t imported = 0;
+        results.push_back(measure("importBinarySTL", "triangle", triangle_count, 5, [&]() { imported = importBinarySTL(stl_file).triangle_count; }));
+        golden(results.back(), triangle_count, imported);
+        std::filesystem::remove(stl_file);
+    }
+
+    // checkpointing: legacy text file of one genome, binary checkpoint of a population of 16
+    {
+        const std::string genome_file = temp_dir + "/collector.genome";
+        results.push_back(measure("serializeToFile", "gene", collector.dna_size, 3, [&]() { serializeToFile(collector, genome_file); }));
+        std::filesystem::remove(genome_file);
+
+        const std::string checkpoint_file = temp_dir + "/population.ckpt";
+        const std::vector<const Genome*> genomes(16, &collector);
+        std::vector<uint32_t> ranking(genomes.size());
+        std::iota(ranking.begin(), ranking.end(), 0u);
+        results.push_back(measure("writeCheckpoint", "gene", double(collector.dna_size) * genomes.size(), 5, [&]() {
+            writeCheckpoint(checkpoint_file, genomes, ranking, 0, BENCH_SEED, 0);
+        }));
+        std::filesystem::remove(checkpoint_file);
+    }
+
+    // report: summary to stderr, JSON to stdout
+    bool golden_ok = true;
+    std::ostringstream json;
+    json.precision(9);
+    json << "{\n  \"grid\": [" << BENCH_XSIZE << ", " << BENCH_YSIZE << "],\n  \"seed\": " << BENCH_SEED
+         << ",\n  \"obstacle_triangles\": " << obs.triangle_count << ",\n  \"benchmarks\": [\n";
+    for (size_t b = 0; b < results.size(); ++b) {
+        const bench_result& r = results[b];
+        const double runs = r.seconds.size();
+        const double mean = std::accumulate(r.seconds.begin(), r.seconds.end(), 0.0) / runs;
+        double variance = 0.0;
+        for (const double s : r.seconds) {
+            variance += (s - mean) * (s - mean);
+        }
+        variance /= runs > 1 ? runs - 1 : 1;
+        const double stddev = std::sqrt(variance);
+        const double min = *std::min_element(r.seconds.begin(), r.seconds.end());
+        const bool ok = !r.has_golden || r.expected == r.actual;
+        golden_ok &= ok;
+
+        json << "    {\"name\": \"" << r.name << "\", \"runs\": " << r.seconds.size() << ", \"unit\": \"" << r.unit << "\", \"units\": " << r.work
+             << ", \"mean_s\": " << mean << ", \"stddev_s\": " << stddev << ", \"min_s\": " << min
+             << ", \"ns_per_unit\": " << mean / r.work * 1e9 << ", \"ns_per_unit_stddev\": " << stddev / r.work * 1e9
+             << ", \"units_per_s\": " << r.work / mean;
+        if (r.has_golden) {
+            json << ", \"golden\": {\"expected\": " << r.expected << ", \"actual\": " << r.actual << ", \"ok\": " << (ok ? "true" : "false") << "}";
+        }
+        json << "}" << (b + 1 < results.size() ? "," : "") << "\n";
+
+        std::cerr << r.name << ":\t" << mean / r.work * 1e9 << " +- " << stddev / r.work * 1e9 << " ns/" << r.unit
+                  << " (" << r.work / mean << " " << r.unit << "s/s)" << (ok ? "" : "  GOLDEN MISMATCH: expected "
+                  + std::to_string(r.expected) + ", got " + std::to_string(r.actual)) << std::endl;
+    }
+    json << "  ],\n  \"golden_ok\": " << (golden_ok ? "true" : "false") << "\n}\n";
+    std::cout << json.str();
+    Stats::show();
+
+    return golden_ok ? 0 : 1;
+}
@@ -0,0 +1,198 @@
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Solar-Collector-Shape-Optimiser/checkpoint.hpp>
+
+// fitness, evaluated_for, dna_min, dna_max, dna_resolution, dna
+size_t CheckpointView::recordSize(const uint32_t dna_size, const uint32_t gene_size) {
+    return sizeof(double) + sizeof(uint64_t) + 3 * sizeof(double) + size_t(dna_size) * gene_size;
+}
+
+// passes the whole checkpoint to `write`, piece by piece (nothing is copied)
+static void writeParts(const std::vector<const Genome*>& genomes, const std::vector<uint32_t>& ranking, const uint64_t generation, 
+                       const uint64_t seed, const uint64_t config_hash, const std::function<void(const void*, size_t)>& write) {
+    if (ranking.size() != genomes.size()) {
+        throw std::runtime_error("Checkpoint ranking has " + std::to_string(ranking.size()) + " entries for " 
+                                 + std::to_string(genomes.size()) + " genomes");
+    }
+
+    checkpoint_header header;
+    header.genome_count = genomes.size();
+    header.dna_size = genomes.empty() ? 0 : genomes[0]->dna_size;
+    header.generation = generation;
+    header.seed = seed;
+    header.config_hash = config_hash;
+
+    write(&header, sizeof(header));
+    for (const Genome* genome : genomes) {
+        if (genome->dna_size != header.dna_size) {
+            throw std::runtime_error("Cannot checkpoint genomes of different sizes: " + std::to_string(genome->dna_size)
+                                     + ", " + std::to_string(header.dna_size));
+        }
+        write(&genome->fitness, sizeof(double));
+        write(&genome->evaluated_for, sizeof(uint64_t));
+        write(&genome->dna_min, sizeof(double));
+        write(&genome->dna_max, sizeof(double));
+        write(&genome->dna_resolution, sizeof(double));
+        write(genome->dna.data(), genome->dna.size() * sizeof(gene_t));
+    }
+    write(ranking.data(), ranking.size() * sizeof(uint32_t));
+}
+
+void writeCheckpoint(const std::string& filename, const std::vector<const Genome*>& genomes, const std::vector<uint32_t>& ranking,
+                     const uint64_t generation, const uint64_t seed, const uint64_t config_hash) {
+    const std::string temp_name = filename + ".tmp";
+    const int fd = ::open(temp_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file for writing: " + temp_name + " (" + std::strerror(errno) + ")");
+    }
+
+    auto writeAll = [&](const void* buffer, size_t count) {
+        const char* bytes = static_cast<const char*>(buffer);
+        while (count > 0) {
+            const ssize_t written = ::write(fd, bytes, count);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error("Error writing to file: " + temp_name + " (" + std::strerror(errno) + ")");
+            }
+            bytes += written;
+            count -= written;
+        }
+    };
+
+    // (a failed checkpoint leaves no temporary file behind)
+    try {
+        writeParts(genomes, ranking, generation, seed, config_hash, writeAll);
+        // the data has to be on disk before the rename makes it the checkpoint
+        if (::fsync(fd) != 0) {
+            throw std::runtime_error("Error flushing file: " + temp_name + " (" + std::strerror(errno) + ")");
+        }
+    } catch (...) {
+        ::close(fd);
+        ::unlink(temp_name.c_str());
+        throw;
+    }
+    if (::close(fd) != 0) {
+        const std::string error = std::strerror(errno);
+        ::unlink(temp_name.c_str());
+        throw std::runtime_error("Error closing file: " + temp_name + " (" + error + ")");
+    }
+    if (::rename(temp_name.c_str(), filename.c_str()) != 0) {
+        const std::string error = std::strerror(errno);
+        ::unlink(temp_name.c_str());
+        throw std::runtime_error("Could not rename " + temp_name + " to " + filename + " (" + error + ")");
+    }
+}
+
+std::vector<char> encodeCheckpoint(const std::vector<const Genome*>& genomes, const std::vector<uint32_t>& ranking,
+                                   const uint64_t generation, const uint64_t seed, const uint64_t config_hash) {
+    std::vector<char> ret;
+    writeParts(genomes, ranking, generation, seed, config_hash, [&](const void* data, const size_t size) {
+        ret.insert(ret.end(), static_cast<const char*>(data), static_cast<const char*>(data) + size);
+    });
+    return ret;
+}
+
+CheckpointView::CheckpointView(const char* data, const size_t size, const std::string& source)
+    : bytes(data)
+{
+    if (size < sizeof(checkpoint_header)) {
+        throw std::runtime_error("Checkpoint is too small: " + source);
+    }
+
+    const checkpoint_header& head = header();
+    const checkpoint_header expected;
+    if (std::memcmp(head.magic, expected.magic, sizeof(head.magic)) != 0) {
+        throw std::runtime_error("Not a checkpoint: " + source);
+    }
+    if (head.version != CHECKPOINT_VERSION) {
+        throw std::runtime_error("Unsupported checkpoint version " + std::to_string(head.version) + ": " + source);
+    }
+    if (head.gene_size != sizeof(double) && head.gene_size != sizeof(uint16_t)) {
+        throw std::runtime_error("Unsupported gene size " + std::to_string(head.gene_size) + ": " + source);
+    }
+    if (size != sizeof(checkpoint_header) + size_t(head.genome_count) * (recordSize(head.dna_size, head.gene_size) + sizeof(uint32_t))) {
+        throw std::runtime_error("Checkpoint is truncated or corrupted: " + source);
+    }
+    try {
+        ranking(); // (throws if it isn't a permutation)
+    } catch (const std::runtime_error& e) {
+        throw std::runtime_error(std::string(e.what()) + ": " + source);
+    }
+}
+
+const checkpoint_header& CheckpointView::header() const {
+    return *reinterpret_cast<const checkpoint_header*>(bytes);
+}
+
+void CheckpointView::restore(const uint32_t idx, Genome& genome) const {
+    const checkpoint_header& head = header();
+    if (idx >= head.genome_count) {
+        throw std::runtime_error("Checkpoint record out of range: " + std::to_string(idx) + " >= " + std::to_string(head.genome_count));
+    }
+    if (genome.dna_size != head.dna_size) {
+        throw std::runtime_error("Checkpoint DNA size mismatch. Expected: " + std::to_string(genome.dna_size)
+                                 + ", got: " + std::to_string(head.dna_size));
+    }
+
+    const char* record = bytes + sizeof(checkpoint_header) + idx * recordSize(head.dna_size, head.gene_size);
+    double dna_min, dna_max, dna_resolution;
+    std::memcpy(&genome.fitness, record, sizeof(double));                           record += sizeof(double);
+    std::memcpy(&genome.evaluated_for, record, sizeof(uint64_t));                   record += sizeof(uint64_t);
+    std::memcpy(&dna_min, record, sizeof(double));                                  record += sizeof(double);
+    std::memcpy(&dna_max, record, sizeof(double));                                  record += sizeof(double);
+    std::memcpy(&dna_resolution, record, sizeof(double));                           record += sizeof(double);
+
+    if (head.gene_size == sizeof(gene_t) && dna_min == genome.dna_min && dna_max == genome.dna_max && dna_resolution == genome.dna_resolution) {
+        std::memcpy(genome.dna.data(), record, size_t(head.dna_size) * sizeof(gene_t));
+        return;
+    }
+
+    // written by a build with other genes, or for another range/resolution
+    for (uint32_t i = 0; i < head.dna_size; ++i) {
+        double value;
+        if (head.gene_size == sizeof(double)) {
+            std::memcpy(&value, record + size_t(i) * sizeof(double), sizeof(double));
+        } else {
+            uint16_t step;
+            std::memcpy(&step, record + size_t(i) * sizeof(uint16_t), sizeof(uint16_t));
+            value = dna_min + step * dna_resolution;
+        }
+        genome.setGene(i, value);
+    }
+    genome.evaluated_for = 0;
+}
+
+const char* CheckpointView::rankingData() const {
+    const checkpoint_header& head = header();
+    return bytes + sizeof(checkpoint_header) + size_t(head.genome_count) * recordSize(head.dna_size, head.gene_size);
+}
+
+std::vector<uint32_t> CheckpointView::ranking() const {
+    const checkpoint_header& head = header();
+    std::vector<uint32_t> ret(head.genome_count);
+    std::memcpy(ret.data(), rankingData(), ret.size() * sizeof(uint32_t));
+
+    // indices into the population - every record exactly once
+    std::vector<bool> seen(ret.size(), false);
+    for (const uint32_t idx : ret) {
+        if (idx >= ret.size() || seen[idx]) {
+            throw std::runtime_error("Checkpoint ranking is not a permutation of its " + std::to_string(ret.size()) + " records");
+        }
+        seen[idx] = true;
+    }
+    return ret;
+}
+
+CheckpointFile::CheckpointFile(const std::string& filename)
+    : file(filename)
+    , view(file.data(), file.size(), filename)
+{}
+
+CheckpointFile::~CheckpointFile() {}
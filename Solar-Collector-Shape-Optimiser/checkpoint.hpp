@@ -0,0 +1,76 @@
+#ifndef CHECKPOINT_HPP
+#define CHECKPOINT_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <Solar-Collector-Shape-Optimiser/genome.hpp>
+#include <Solar-Collector-Shape-Optimiser/mappedfile.hpp>
+
+// version of the binary checkpoint layout - bump it whenever the layout changes
+constexpr uint32_t CHECKPOINT_VERSION = 2;
+
+// binary checkpoint: this header followed by `genome_count` records of
+//   double fitness, uint64_t evaluated_for, double dna_min, double dna_max, double dna_resolution, gene_t dna[dna_size]
+// (genes as stored by the build that wrote the file - `gene_size` bytes each)
+// and by `genome_count` uint32_t - the ranking of the records (best first)
+// in native byte order (checkpoints are meant to be resumed on the machine that wrote them)
+struct checkpoint_header {
+    char magic[8];          // "SCSOCKPT"
+    uint32_t version;       // CHECKPOINT_VERSION
+    uint32_t genome_count;  // number of records
+    uint32_t dna_size;      // number of genes of every record
+    uint32_t gene_size;     // bytes per gene (sizeof(gene_t) of the build that wrote it)
+    uint64_t generation;    // generation to continue with
+    uint64_t seed;          // seed of the run - with the generation it is the whole state of the random streams
+    uint64_t config_hash;   // key of the setup (rays, obstacle, grid, ...) the fitnesses were computed for
+
+    checkpoint_header() : magic{'S', 'C', 'S', 'O', 'C', 'K', 'P', 'T'}, version(CHECKPOINT_VERSION), genome_count(0), dna_size(0)
+                        , gene_size(sizeof(gene_t)), generation(0), seed(0), config_hash(0) {};
+};
+
+// writes `genomes` (in this order) and their `ranking` (indices into `genomes`) into `filename`: the data goes to a
+// temporary file first, which is flushed to disk and renamed over `filename` - a crash while checkpointing leaves the
+// previous checkpoint intact
+void writeCheckpoint(const std::string& filename, const std::vector<const Genome*>& genomes, const std::vector<uint32_t>& ranking,
+                     const uint64_t generation, const uint64_t seed, const uint64_t config_hash);
+// the same layout in memory (ex. genomes migrating to another island, see Island)
+std::vector<char> encodeCheckpoint(const std::vector<const Genome*>& genomes, const std::vector<uint32_t>& ranking,
+                                   const uint64_t generation, const uint64_t seed, const uint64_t config_hash);
+
+// checkpoint in memory, validated when constructed (`data` must outlive it); `source` names it in errors
+class CheckpointView {
+public:
+    CheckpointView(const char* data, const size_t size, const std::string& source);
+
+    const checkpoint_header& header() const;
+    // copies record `idx` into `genome` (its dna must have the same size); genes stored with a different gene size, range
+    // or resolution are converted to the genome's (and its fitness has to be recomputed)
+    void restore(const uint32_t idx, Genome& genome) const;
+    // indices of the records, best first (a permutation of [0, genome_count), else it throws)
+    std::vector<uint32_t> ranking() const;
+
+private:
+    const char* bytes;
+
+    static size_t recordSize(const uint32_t dna_size, const uint32_t gene_size);
+    const char* rankingData() const;
+};
+
+// read-only, memory-mapped checkpoint (validated when opened)
+class CheckpointFile {
+public:
+    explicit CheckpointFile(const std::string& filename);
+    ~CheckpointFile();
+
+    const checkpoint_header& header() const { return view.header(); }
+    void restore(const uint32_t idx, Genome& genome) const { view.restore(idx, genome); }
+    std::vector<uint32_t> ranking() const { return view.ranking(); }
+
+private:
+    MappedFile file;
+    CheckpointView view;
+};
+
+#endif // CHECKPOINT_HPP
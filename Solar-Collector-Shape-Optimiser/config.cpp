@@ -1,11 +1,15 @@
 #include <cstdint>
 #include <stdexcept>
+#include <limits>
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <random>
 
 #include "Solar-Collector-Shape-Optimiser/config.hpp"
+#include "Solar-Collector-Shape-Optimiser/acceptancemap.hpp"
 
 // Initialize static members
 uint32_t Config::xsize = 0;   // Default values, will be overwritten by config file
@@ -24,6 +28,39 @@ uint32_t Config::export_every = 0;
 
 bool Config::start_from_checkpoint = false;
 
+uint64_t Config::seed = 0;
+
+double Config::shadow_table_resolution = 1.0;
+
+uint32_t Config::acceptance_resolution = 0;
+double Config::acceptance_cell_size = 4.0;
+uint32_t Config::acceptance_layers = 16;
+
+uint32_t Config::fitness_cache_size = 1024;
+
+std::string Config::mesh_storage = "heightmap";
+
+double Config::gene_resolution = 0.0;
+
+std::string Config::encoding = "heightmap";
+double Config::control_spacing = 10.0;
+
+uint32_t Config::coarse_levels = 0;
+uint32_t Config::stage_patience = 25;
+
+uint32_t Config::io_queue_size = 2;
+
+bool Config::perf_counters = false;
+uint64_t Config::perf_vector_event = 0;
+
+uint32_t Config::trace_every = 0;
+uint32_t Config::trace_buffer_size = 65536;
+
+std::string Config::island_listen = "";
+std::string Config::island_send_to = "";
+uint32_t Config::migration_every = 10;
+uint32_t Config::migration_size = 2;
+
 std::vector<vertex> Config::rays;
 std::map<std::string, std::string> Config::settings;
 
@@ -99,6 +136,56 @@ void Config::loadFromFile(const std::string& filename) {
         export_every = std::stoul(settings.at("export_every"));
 
         start_from_checkpoint = settings.at("start_from_checkpoint")=="true";
+
+        // optional settings
+        if (settings.contains("seed")) {
+            seed = std::stoull(settings.at("seed"));
+        }
+        else {
+            std::random_device rd;
+            seed = (uint64_t(rd()) << 32) | rd();
+        }
+        if (settings.contains("shadow_table_resolution"))
+            shadow_table_resolution = std::stod(settings.at("shadow_table_resolution"));
+        if (settings.contains("acceptance_resolution"))
+            acceptance_resolution = std::min<unsigned long>(std::stoul(settings.at("acceptance_resolution")), 
+                                                            std::numeric_limits<uint32_t>::max()); // (rejected below)
+        if (settings.contains("acceptance_cell_size"))
+            acceptance_cell_size = std::stod(settings.at("acceptance_cell_size"));
+        if (settings.contains("acceptance_layers"))
+            acceptance_layers = std::stoul(settings.at("acceptance_layers"));
+        if (settings.contains("fitness_cache_size"))
+            fitness_cache_size = std::stoul(settings.at("fitness_cache_size"));
+        if (settings.contains("mesh_storage"))
+            mesh_storage = settings.at("mesh_storage");
+        if (settings.contains("gene_resolution"))
+            gene_resolution = std::stod(settings.at("gene_resolution"));
+        if (settings.contains("encoding"))
+            encoding = settings.at("encoding");
+        if (settings.contains("control_spacing"))
+            control_spacing = std::stod(settings.at("control_spacing"));
+        if (settings.contains("coarse_levels"))
+            coarse_levels = std::stoul(settings.at("coarse_levels"));
+        if (settings.contains("stage_patience"))
+            stage_patience = std::stoul(settings.at("stage_patience"));
+        if (settings.contains("io_queue_size"))
+            io_queue_size = std::stoul(settings.at("io_queue_size"));
+        if (settings.contains("perf_counters"))
+            perf_counters = settings.at("perf_counters") == "true";
+        if (settings.contains("perf_vector_event"))
+            perf_vector_event = std::stoull(settings.at("perf_vector_event"), nullptr, 0); // hex with 0x
+        if (settings.contains("trace_every"))
+            trace_every = std::stoul(settings.at("trace_every"));
+        if (settings.contains("trace_buffer_size"))
+            trace_buffer_size = std::stoul(settings.at("trace_buffer_size"));
+        if (settings.contains("island_listen"))
+            island_listen = settings.at("island_listen");
+        if (settings.contains("island_send_to"))
+            island_send_to = settings.at("island_send_to");
+        if (settings.contains("migration_every"))
+            migration_every = std::stoul(settings.at("migration_every"));
+        if (settings.contains("migration_size"))
+            migration_size = std::stoul(settings.at("migration_size"));
     
     } catch (const std::out_of_range& oor) {
         throw std::runtime_error("Missing or invalid configuration value: " + std::string(oor.what()));
@@ -114,6 +201,39 @@ void Config::loadFromFile(const std::string& filename) {
     if( popsize == 0 )
       throw std::runtime_error("popsize needs to be greater than 0!");
 
+    if( shadow_table_resolution < 0 )
+      throw std::runtime_error("shadow_table_resolution can't be negative!");
+
+    if( acceptance_resolution > 0 && (acceptance_cell_size <= 0 || acceptance_layers == 0) )
+      throw std::runtime_error("acceptance_cell_size and acceptance_layers need to be greater than 0!");
+
+    if( acceptance_resolution > ACCEPTANCE_MAX_RESOLUTION )
+      throw std::runtime_error("acceptance_resolution can't be greater than " + std::to_string(ACCEPTANCE_MAX_RESOLUTION) + "!");
+
+    if( gene_resolution < 0 )
+      throw std::runtime_error("gene_resolution can't be negative!");
+
+#ifdef QUANTISED_GENES
+    // heights go up to hmax + 1 (see main)
+    if( gene_resolution > 0 && (hmax + 1.0) / gene_resolution > std::numeric_limits<uint16_t>::max() )
+      throw std::runtime_error("gene_resolution is too fine for 16-bit genes, it needs to be at least (hmax + 1) / 65535!");
+#endif // QUANTISED_GENES
+
+    if( encoding != "heightmap" && encoding != "bspline" )
+      throw std::runtime_error("encoding needs to be 'heightmap' or 'bspline'!");
+
+    if( encoding == "bspline" && control_spacing <= 0 )
+      throw std::runtime_error("control_spacing needs to be greater than 0!");
+
+    if( coarse_levels > 16 )
+      throw std::runtime_error("coarse_levels can't be greater than 16!");
+
+    if( mesh_storage != "arena" && mesh_storage != "heightmap" )
+      throw std::runtime_error("mesh_storage needs to be 'arena' or 'heightmap'!");
+
+    if( !island_listen.empty() && (migration_every == 0 || migration_size == 0) )
+      throw std::runtime_error("migration_every and migration_size need to be greater than 0!");
+
     if(popsize % 4)
         std::cerr << "Warning: Population Size is not divisible by 4!\n"; //not an error, just a qol warning
 
@@ -26,6 +26,39 @@ public:
 
     static bool start_from_checkpoint;
 
+    static uint64_t seed; // seed of all random numbers of a run (random if not set)
+
+    static double shadow_table_resolution; // cell size of the ShadowTable grid (mm), 0 traces shadow rays instead
+
+    static uint32_t acceptance_resolution; // texels along each side of an AcceptanceMap bitmap, 0 traces reflected rays instead
+    static double acceptance_cell_size;    // size (mm) of an AcceptanceMap cell along x and z
+    static uint32_t acceptance_layers;     // number of AcceptanceMap cells along the height
+
+    static uint32_t fitness_cache_size; // number of entries of the FitnessCache, 0 disables it
+
+    static std::string mesh_storage; // "heightmap" (triangles derived on the fly) or "arena" (shape data per individual in a MeshArena)
+
+    static double gene_resolution; // step of the heights in mm, 0 for continuous heights (65535 steps with quantised genes)
+
+    static std::string encoding;    // "heightmap" (a gene per height) or "bspline" (genes are control points of a smooth surface)
+    static double control_spacing;  // distance (mm) between B-spline control points
+
+    static uint32_t coarse_levels;  // number of coarser grids (each half the resolution of the next) optimised before the full one
+    static uint32_t stage_patience; // generations without a better best individual that end a coarse stage
+
+    static uint32_t io_queue_size; // number of checkpoints/exports waiting for the background IoWorker, 0 writes them synchronously
+
+    static bool perf_counters;          // hardware counters per Stats phase (perf_event_open)
+    static uint64_t perf_vector_event;  // raw event code of vector instructions for perf_counters, 0 for none
+
+    static uint32_t trace_every;        // generations between dumps of the threads' timeline (Chrome trace JSON), 0 disables tracing
+    static uint32_t trace_buffer_size;  // spans kept per thread
+
+    static std::string island_listen;   // address other islands send migrants to ("unix:<path>" or "tcp:<host>:<port>"), empty for a single population
+    static std::string island_send_to;  // address of the next island, migrants of this one go there (empty: only receive)
+    static uint32_t migration_every;    // generations between migrations
+    static uint32_t migration_size;     // best individuals sent per migration
+
     static std::vector<vertex> rays;
 
     // Static method to load configuration from a file
@@ -0,0 +1,84 @@
+#include <cstring>
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <Solar-Collector-Shape-Optimiser/filewriter.hpp>
+
+FileWriter::FileWriter(const std::string& filename)
+    : filename(filename)
+    , fd(::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644))
+    , buffer(BUFFER_SIZE)
+    , used(0)
+{
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file for writing: " + filename + " (" + std::strerror(errno) + ")");
+    }
+}
+
+FileWriter::~FileWriter() {
+    try {
+        close();
+    } catch (...) {
+        // destructors can't throw - call close() to see errors
+    }
+}
+
+void FileWriter::write(const void* data, const size_t size) {
+    if (size > buffer.size()) {
+        flush();
+        writeOut(static_cast<const char*>(data), size); // too big to buffer
+        return;
+    }
+    std::memcpy(reserve(size), data, size);
+    used += size;
+}
+
+void FileWriter::writeScientific(const double value) {
+    constexpr size_t MAX_LENGTH = 32; // sign, 1 digit, point, 6 digits, exponent (up to e+308)
+    char* out = reserve(MAX_LENGTH);
+    const std::to_chars_result result = std::to_chars(out, out + MAX_LENGTH, value, std::chars_format::scientific, 6);
+    if (result.ec != std::errc()) {
+        throw std::runtime_error("Could not format " + std::to_string(value) + " for " + filename);
+    }
+    used += result.ptr - out;
+}
+
+void FileWriter::writeOut(const char* bytes, size_t count) {
+    while (count > 0) {
+        const ssize_t written = ::write(fd, bytes, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            throw std::runtime_error("Error writing to file: " + filename + " (" + std::strerror(errno) + ")");
+        }
+        bytes += written;
+        count -= written;
+    }
+}
+
+void FileWriter::flush() {
+    writeOut(buffer.data(), used);
+    used = 0;
+}
+
+void FileWriter::close() {
+    if (fd < 0) {
+        return;
+    }
+    try {
+        flush();
+    } catch (...) {
+        ::close(fd);
+        fd = -1;
+        throw;
+    }
+    const int result = ::close(fd);
+    fd = -1;
+    if (result != 0) {
+        throw std::runtime_error("Error closing file: " + filename + " (" + std::strerror(errno) + ")");
+    }
+}
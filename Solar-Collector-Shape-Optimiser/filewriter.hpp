@@ -0,0 +1,44 @@
+#ifndef FILEWRITER_HPP
+#define FILEWRITER_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// buffered sequential writer: data is gathered in one fixed-size buffer which is written to the file whenever it fills
+// up, so writing a file of any size takes constant memory
+class FileWriter {
+public:
+    static constexpr size_t BUFFER_SIZE = 1 << 20;
+
+    explicit FileWriter(const std::string& filename);
+    FileWriter(const FileWriter&) = delete;
+    FileWriter& operator=(const FileWriter&) = delete;
+    ~FileWriter(); // closes the file, use close() to get errors
+
+    void write(const void* data, const size_t size);
+    void write(const std::string& text) { write(text.data(), text.size()); }
+    // appends `value` in scientific notation with 6 digits after the point (as printed by std::scientific)
+    void writeScientific(const double value);
+    // writes the buffer out and closes the file (does nothing if it's closed already)
+    void close();
+
+private:
+    std::string filename;
+    int fd;
+    std::vector<char> buffer;
+    size_t used; // bytes of 'buffer' holding data
+
+    void writeOut(const char* bytes, size_t count);
+    void flush();
+    // makes room for `size` more bytes in the buffer, returns where they go
+    char* reserve(const size_t size) {
+        if (used + size > buffer.size()) {
+            flush();
+        }
+        return buffer.data() + used;
+    }
+};
+
+#endif // FILEWRITER_HPP
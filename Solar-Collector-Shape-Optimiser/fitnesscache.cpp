@@ -0,0 +1,41 @@
+#include <stdexcept>
+
+#include <Solar-Collector-Shape-Optimiser/fitnesscache.hpp>
+
+FitnessCache::FitnessCache(const uint32_t capacity)
+    : hits(Stats::counter("CacheHits"))
+    , misses(Stats::counter("CacheMisses"))
+    , entries(capacity)
+    , mutex()
+{
+    if (capacity == 0) {
+        throw std::runtime_error("FitnessCache needs a capacity greater than 0");
+    }
+}
+
+FitnessCache::~FitnessCache() {}
+
+// lookups happen once per offspring, so a single lock is cheap compared to tracing
+bool FitnessCache::find(const uint64_t dna_hash, double& fitness) {
+    bool found = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const cache_entry& entry = entries[dna_hash % entries.size()];
+        if (entry.used && entry.dna_hash == dna_hash) {
+            fitness = entry.fitness;
+            found = true;
+        }
+    }
+    Stats::add(found ? hits : misses, 1);
+    return found;
+}
+
+void FitnessCache::insert(const uint64_t dna_hash, const double fitness) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    cache_entry& entry = entries[dna_hash % entries.size()];
+    entry.dna_hash = dna_hash;
+    entry.fitness = fitness;
+    entry.used = true;
+}
@@ -0,0 +1,38 @@
+#ifndef FITNESSCACHE_HPP
+#define FITNESSCACHE_HPP
+
+#include <cstdint>
+#include <vector>
+#include <mutex>
+
+#include <Solar-Collector-Shape-Optimiser/stats.hpp>
+
+// fitness of recently evaluated genomes, keyed by the hash of their shape (see SolarCollector::hashShape)
+// identical offspring (ex. from crossover of converged parents) then take their fitness from here instead of being traced
+// direct-mapped: a newer genome overwrites an older one with the same slot; safe to use from parallel tasks
+class FitnessCache {
+public:
+    const stat_id hits;   // Stats counter of successful lookups
+    const stat_id misses; // Stats counter of failed lookups
+
+    explicit FitnessCache(const uint32_t capacity);
+    // copy, move constructors, assignments are deleted (std::mutex)
+    ~FitnessCache();
+
+    bool find(const uint64_t dna_hash, double& fitness);
+    void insert(const uint64_t dna_hash, const double fitness);
+
+private:
+    struct cache_entry {
+        uint64_t dna_hash;
+        double fitness;
+        bool used;
+
+        cache_entry() : dna_hash(0), fitness(0.0), used(false) {};
+    };
+
+    std::vector<cache_entry> entries;
+    std::mutex mutex;
+};
+
+#endif // FITNESSCACHE_HPP
@@ -1,56 +1,100 @@
 #include <cstdint>
 #include <vector>
 #include <ostream>
-#include <execution>
+#include <algorithm>
+#include <numeric>
 #include <sstream>
 #include <fstream>
-// #include <stdexcept>
+#include <stdexcept>
+#include <string>
 
 #include <Solar-Collector-Shape-Optimiser/genome.hpp>
+#include <Solar-Collector-Shape-Optimiser/rng.hpp>
+#include <Solar-Collector-Shape-Optimiser/hash.hpp>
 
 
-Genome::Genome(const uint32_t dna_size, const double dna_min, const double dna_max)
+Genome::Genome(const uint32_t dna_size, const double dna_min, const double dna_max, const double dna_resolution)
     : dna_size(dna_size)  
     , dna(dna_size)
     , fitness(0.0)
+    , evaluated_for(0)
     , dna_min(dna_min)
     , dna_max(dna_max)
-{}
+    , dna_resolution(dna_resolution)
+    , gene_steps(0.0)
+{
+    if (dna_resolution < 0.0 || dna_min > dna_max) {
+        throw std::runtime_error("Invalid gene range [" + std::to_string(dna_min) + ", " + std::to_string(dna_max) 
+                                 + "] or resolution " + std::to_string(dna_resolution));
+    }
+    #ifdef QUANTISED_GENES
+        if (!std::isfinite(dna_max - dna_min)) {
+            throw std::runtime_error("Quantised genes need a finite range");
+        }
+        if (this->dna_resolution == 0.0) {
+            this->dna_resolution = dna_max > dna_min ? (dna_max - dna_min) / std::numeric_limits<gene_t>::max() : 1.0;
+        }
+    #endif // QUANTISED_GENES
+    if (this->dna_resolution > 0.0) {
+        gene_steps = std::floor((dna_max - dna_min) / this->dna_resolution);
+        #ifdef QUANTISED_GENES
+            if (gene_steps > std::numeric_limits<gene_t>::max()) {
+                throw std::runtime_error("Gene resolution " + std::to_string(this->dna_resolution) + " is too fine for 16-bit genes in [" 
+                                         + std::to_string(dna_min) + ", " + std::to_string(dna_max) + "]");
+            }
+        #endif // QUANTISED_GENES
+    }
+    // every gene starts at the value closest to 0
+    std::fill(dna.begin(), dna.end(), encodeGene(0.0));
+}
 
 Genome::Genome(const Genome &parent1, const Genome &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range) 
-    : Genome(parent1.dna_size, parent1.dna_min, parent1.dna_max) 
+    : Genome(parent1.dna_size, parent1.dna_min, parent1.dna_max, parent1.dna_resolution) 
 {
+    breed(parent1, parent2, crossover_bias, mutation_probability, mutation_range);
+}
+
+void Genome::breed(const Genome &parent1, const Genome &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range) {
+    breed(parent1, parent2, crossover_bias, mutation_probability, mutation_range, threadRng());
+}
 
-    // TODO: random device and distributions could be static (but that takes away the control to dynamically change them with each crossoverAnd.. call (can be passed to function))
-    std::random_device rd;  // Used only to seed the mt19937 generator. Seeding should ideally happen once per thread
-    std::mt19937 mt(rd()); // thread_local would ensure each thread has its own generator.
-
-    // Crossover bias (probability of using genes from the first parent (this))
-    std::bernoulli_distribution crossover_choice_dist(crossover_bias);
-    // Mutation (probability of applying mutation and it's amount)
-    std::bernoulli_distribution mutation_choice_dist(mutation_probability);
-    std::uniform_real_distribution<double> mutation_amount_dist(-mutation_range, mutation_range);
-
-    // Use std::transform with std::execution::par_unseq (parallel execution)
-    std::transform(
-    #ifndef NO_STD_EXECUTION
-        std::execution::unseq, 
-    #endif // NO_STD_EXECUTIOn
-        parent1.dna.begin(), parent1.dna.end(), 
-        parent2.dna.begin(), 
-        dna.begin(),
-        [&](double dna1_val, double dna2_val) {
-            const bool crossover_choice = crossover_choice_dist(mt);
-            const bool mutation_flag = mutation_choice_dist(mt);
-            const double mutation_amount = mutation_amount_dist(mt);
+void Genome::breed(const Genome &parent1, const Genome &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range, 
+                   RngStream& rng) {
+    if (parent1.dna_size != dna_size || parent2.dna_size != dna_size) {
+        throw std::runtime_error("Cannot breed genomes of different sizes: " + std::to_string(parent1.dna_size) + ", " 
+                                 + std::to_string(parent2.dna_size) + " into " + std::to_string(dna_size));
+    }
+    fitness = 0.0;
+    evaluated_for = 0;
+
+    // random numbers are drawn in blocks (crossover choices, mutation choices and mutation amounts for BREED_BLOCK genes),
+    // so that the genes themselves are merged in a branchless loop
+    alignas(64) double crossover_u[BREED_BLOCK];
+    alignas(64) double mutation_u[BREED_BLOCK];
+    alignas(64) double amount_u[BREED_BLOCK];
+
+    for (uint32_t base = 0; base < dna_size; base += BREED_BLOCK) {
+        const uint32_t count = std::min(BREED_BLOCK, dna_size - base);
+        rng.fill(crossover_u, count);
+        rng.fill(mutation_u, count);
+        rng.fill(amount_u, count);
+
+        const gene_t* dna1 = parent1.dna.data() + base;
+        const gene_t* dna2 = parent2.dna.data() + base;
+        gene_t* out = dna.data() + base;
+        for (uint32_t i = 0; i < count; ++i) {
+            // Crossover bias (probability of using genes from the first parent)
+            const bool crossover_choice = crossover_u[i] < crossover_bias;
+            // Mutation (probability of applying mutation and it's amount in [-mutation_range, mutation_range))
+            const bool mutation_flag = mutation_u[i] < mutation_probability;
+            const double mutation_amount = (2.0 * amount_u[i] - 1.0) * mutation_range;
 
             // merge two dnas
-            const double ret = (crossover_choice ? dna1_val : dna2_val) + (mutation_flag ? mutation_amount : 0.0);
-            // clamp to desired dna_min and max values
-            return std::clamp(ret, dna_min, dna_max);
+            const double ret = decodeGene(crossover_choice ? dna1[i] : dna2[i]) + (mutation_flag ? mutation_amount : 0.0);
+            // clamp to desired dna_min and max values (and round to dna_resolution)
+            out[i] = encodeGene(ret);
         }
-    );
-
+    }
 }
 
 Genome::~Genome() {}
@@ -63,21 +107,39 @@ double Genome::calcSimilarity(const Genome &other) const {
     const double elem_count = dna_size;
     const double magnitude = dna_max - dna_min;
 
-    // Use std::inner_product (sum of absolute values of differences on each field of DNA)
-    const double acc = 
-        std::inner_product(
-            dna.begin(), dna.end(), 
-            other.dna.begin(), 
-            (double)0.0,
-            std::plus<>(), 
-            [&](double dna1_val, double dna2_val) {
-                return std::abs(dna1_val - dna2_val);
-            }
-        );
+    #ifdef QUANTISED_GENES
+        // sum of differences in steps (exact in integers), scaled once
+        const double acc = dna_resolution * 
+            std::inner_product(
+                dna.begin(), dna.end(), 
+                other.dna.begin(), 
+                (uint64_t)0,
+                std::plus<>(), 
+                [](gene_t dna1_val, gene_t dna2_val) {
+                    return uint64_t(dna1_val > dna2_val ? dna1_val - dna2_val : dna2_val - dna1_val);
+                }
+            );
+    #else
+        // Use std::inner_product (sum of absolute values of differences on each field of DNA)
+        const double acc = 
+            std::inner_product(
+                dna.begin(), dna.end(), 
+                other.dna.begin(), 
+                (double)0.0,
+                std::plus<>(), 
+                [&](double dna1_val, double dna2_val) {
+                    return std::abs(dna1_val - dna2_val);
+                }
+            );
+    #endif // QUANTISED_GENES
     
     return acc / (elem_count * magnitude) ;
 }
 
+// identical dna (same size and genes) gives the same hash
+uint64_t Genome::hashDNA() const {
+    return hashBytes(dna.data(), dna.size() * sizeof(gene_t), dna_size);
+}
 
 std::ostream& operator<<(std::ostream& os, const Genome& genome) {
     os << "Chromosome Size: " << genome.dna_size << ", Fitness: " << genome.fitness;
@@ -99,8 +161,8 @@ void serializeToFile(const Genome& genome, const std::string& filename) {
     ss << genome.dna_max << " ";
 
     // Serialize the DNA vector.  Iterate and add each element to the stream.
-    for (const double& gene : genome.dna) {
-        ss << gene << " ";
+    for (const gene_t& gene : genome.dna) {
+        ss << genome.decodeGene(gene) << " ";
     }
 
     file << ss.rdbuf();
@@ -111,7 +173,7 @@ void serializeToFile(const Genome& genome, const std::string& filename) {
     file.close(); // Explicit close for clarity (RAII handles it, but this is good practice)
 }
 
-Genome deserializeFromFile(const std::string& filename) {
+void deserializeFromFile(const std::string& filename, Genome& genome) {
     uint32_t dna_size;
     double fitness;
     double dna_min, dna_max;
@@ -153,15 +215,14 @@ Genome deserializeFromFile(const std::string& filename) {
         throw std::runtime_error("Failed to deserialize dna vector: invalid data.");
     }
 
-    if (dna.size() != dna_size) {
-        throw std::runtime_error("Deserialized DNA size mismatch. Expected: " + std::to_string(dna_size) + ", got: " + std::to_string(dna.size()));
+    if (dna.size() != dna_size || dna_size != genome.dna_size) {
+        throw std::runtime_error("Deserialized DNA size mismatch. Expected: " + std::to_string(genome.dna_size) + ", got: " + std::to_string(dna.size()));
     }
 
-    // Create and return the Genome object.
-    Genome genome(dna_size, dna_min, dna_max); // Use constructor to initialize
-    genome.dna = std::move(dna);             // Efficient move assignment
+    // genes are stored in the genome's own range and resolution (the file's range isn't used)
+    for (uint32_t i = 0; i < dna_size; ++i) {
+        genome.setGene(i, dna[i]);
+    }
     genome.fitness = fitness;
-
-    return genome;
-
+    genome.evaluated_for = 0;
 }
@@ -5,35 +5,86 @@
 #include <vector>
 #include <random>
 #include <limits>
+#include <algorithm>
+#include <cmath>
 #include <string>
 
+#include <Solar-Collector-Shape-Optimiser/rng.hpp>
+
+// storage of a gene
+// build with -DQUANTISED_GENES to store genes as 16-bit fixed point (steps of 'dna_resolution' above 'dna_min'), a
+// quarter of the memory of double genes; a double build with the same 'dna_resolution' snaps its genes to the same
+// steps and gives bit-identical results (regression mode)
+#ifdef QUANTISED_GENES
+    using gene_t = uint16_t;
+#else
+    using gene_t = double;
+#endif // QUANTISED_GENES
+
+// number of genes whose random numbers are generated in one batch by Genome::breed
+constexpr uint32_t BREED_BLOCK = 256;
 
 // note to self: it's good that dna is unique, meaning that the order of "genes" matters (ex. 100101 gives a different specimen than any other permutation of genes of this length)
 class Genome {
 public:
     // add age, max age and "immortal" elites
     uint32_t dna_size; // number of chromosomes - size of dna vector
-    std::vector<double> dna; // 1-d array of doubles (maybe type <T>?) that hold the instruction to create inheriting object
+    std::vector<gene_t> dna; // 1-d array of genes that hold the instruction to create inheriting object (see gene() and setGene())
     double fitness; // fitness of this set of chromosomes
+    uint64_t evaluated_for; // key of the setup (rays, obstacle, ...) 'fitness' was computed for, 0 if it wasn't computed yet
 
     // these should be const but it breaks implicit copy, move constructors, assignments
     double dna_min;
     double dna_max;
+    double dna_resolution; // genes are multiples of it above dna_min, 0 for continuous genes (double genes only)
+    double gene_steps;     // number of steps of dna_resolution that fit in [dna_min, dna_max]
 
 
-    Genome(const uint32_t dna_size, const double dna_min = std::numeric_limits<double>::lowest(), const double dna_max = std::numeric_limits<double>::max());
+    // with quantised genes the range must be finite; a dna_resolution of 0 then splits it into 65535 steps
+    Genome(const uint32_t dna_size, const double dna_min = std::numeric_limits<double>::lowest(), const double dna_max = std::numeric_limits<double>::max(),
+           const double dna_resolution = 0.0);
     Genome(const Genome &parent1, const Genome &parent2, const double& crossover_bias = 0.5, const double& mutation_probability = 0.0, const double& mutation_range = 0.0);
     // copy, move constructors, assignments can be default
     auto operator<=>(const Genome &other) const { return std::compare_three_way{}(fitness, other.fitness); }
     virtual ~Genome();
 
+    // crossover and mutation of two parents written over this genome's dna (no reallocation)
+    // random numbers come from `rng`, or from the calling thread's stream (threadRng) if none is passed
+    void breed(const Genome &parent1, const Genome &parent2, const double& crossover_bias = 0.5, const double& mutation_probability = 0.0, const double& mutation_range = 0.0);
+    void breed(const Genome &parent1, const Genome &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range, 
+               RngStream& rng);
     double calcSimilarity(const Genome &other) const;
+    uint64_t hashDNA() const;
+
+    // value of a stored gene, and stored gene of a value (clamped to [dna_min, dna_max], rounded to dna_resolution)
+    double decodeGene(const gene_t gene) const {
+        #ifdef QUANTISED_GENES
+            return dna_min + gene * dna_resolution;
+        #else
+            return gene;
+        #endif // QUANTISED_GENES
+    }
+    gene_t encodeGene(const double value) const {
+        const double clamped = std::clamp(value, dna_min, dna_max);
+        if (dna_resolution == 0.0) {
+            return gene_t(clamped); // never for quantised genes
+        }
+        const double step = std::min(std::nearbyint((clamped - dna_min) / dna_resolution), gene_steps);
+        #ifdef QUANTISED_GENES
+            return gene_t(step);
+        #else
+            return dna_min + step * dna_resolution;
+        #endif // QUANTISED_GENES
+    }
+    double gene(const uint32_t idx) const { return decodeGene(dna[idx]); }
+    void setGene(const uint32_t idx, const double value) { dna[idx] = encodeGene(value); }
 
     friend std::ostream& operator<<(std::ostream& os, const Genome& genome);
 
 };
 
 void serializeToFile(const Genome& genome, const std::string& filename);
-Genome deserializeFromFile(const std::string& filename);
+// genes of the file are stored into `genome` (same dna size), clamped and rounded to its range and resolution
+void deserializeFromFile(const std::string& filename, Genome& genome);
 
 #endif // GENOME_HPP
\ No newline at end of file
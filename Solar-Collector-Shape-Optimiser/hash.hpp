@@ -0,0 +1,33 @@
+#ifndef HASH_HPP
+#define HASH_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// 64-bit hash of a block of memory, word by word (fast and well mixed, but not cryptographic)
+// `h` chains hashes of several blocks: hashBytes(b, nb, hashBytes(a, na))
+inline uint64_t hashBytes(const void* data, const size_t size, uint64_t h = 0x9E3779B97F4A7C15) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    auto mix = [](uint64_t x) {
+        // splitmix64 finalizer
+        x ^= x >> 30; x *= 0xBF58476D1CE4E5B9;
+        x ^= x >> 27; x *= 0x94D049BB133111EB;
+        x ^= x >> 31;
+        return x;
+    };
+
+    size_t i = 0;
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes + i, 8);
+        h = (h ^ word) * 0x9E3779B97F4A7C15;
+        h ^= h >> 29;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, bytes + i, size - i);
+    return mix(h ^ tail ^ size);
+}
+
+#endif // HASH_HPP
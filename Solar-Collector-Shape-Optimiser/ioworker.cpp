@@ -0,0 +1,87 @@
+#include <Solar-Collector-Shape-Optimiser/ioworker.hpp>
+#include <Solar-Collector-Shape-Optimiser/trace.hpp>
+
+IoWorker::IoWorker(const uint32_t capacity)
+    : capacity(capacity)
+    , jobs()
+    , busy(false)
+    , stopping(false)
+    , error(nullptr)
+    , mutex()
+    , changed()
+    , thread()
+{
+    if (capacity > 0) {
+        thread = std::thread(&IoWorker::run, this);
+    }
+}
+
+IoWorker::~IoWorker() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void IoWorker::submit(std::function<void()> job) {
+    if (capacity == 0) {
+        job();
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return jobs.size() < capacity || error; });
+    rethrow();
+    jobs.push_back(std::move(job));
+    lock.unlock();
+    changed.notify_all();
+}
+
+void IoWorker::drain() {
+    std::unique_lock<std::mutex> lock(mutex);
+    changed.wait(lock, [&] { return (jobs.empty() && !busy) || error; });
+    rethrow();
+}
+
+void IoWorker::rethrow() {
+    if (error) {
+        std::exception_ptr e = error;
+        error = nullptr;
+        std::rethrow_exception(e);
+    }
+}
+
+void IoWorker::run() {
+    Trace::nameThread("IoWorker");
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        changed.wait(lock, [&] { return !jobs.empty() || stopping; });
+        if (jobs.empty()) {
+            return; // stopping, and every job is done
+        }
+
+        std::function<void()> job = std::move(jobs.front());
+        jobs.pop_front();
+        busy = true;
+        lock.unlock();
+        changed.notify_all(); // room in the queue
+
+        try {
+            job();
+        } catch (...) {
+            lock.lock();
+            if (!error) {
+                error = std::current_exception();
+            }
+            lock.unlock();
+        }
+
+        lock.lock();
+        busy = false;
+        changed.notify_all();
+    }
+}
@@ -0,0 +1,42 @@
+#ifndef IOWORKER_HPP
+#define IOWORKER_HPP
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <exception>
+
+// background thread that runs I/O jobs (checkpoints, STL exports) in submission order while the GA keeps computing
+// jobs must own the data they write (a snapshot) - the population changes while they run
+// the queue is bounded: submit blocks while `capacity` jobs are pending, so a slow disk slows the GA down instead of
+// piling up snapshots in memory; a capacity of 0 runs every job synchronously in submit
+class IoWorker {
+public:
+    explicit IoWorker(const uint32_t capacity);
+    IoWorker(const IoWorker&) = delete;
+    IoWorker& operator=(const IoWorker&) = delete;
+    ~IoWorker(); // finishes pending jobs
+
+    // errors of a job are rethrown by the next submit or drain
+    void submit(std::function<void()> job);
+    // waits until every submitted job is done
+    void drain();
+
+private:
+    const uint32_t capacity;
+    std::deque<std::function<void()> > jobs;
+    bool busy;     // a job is running
+    bool stopping;
+    std::exception_ptr error; // first error of a job, not rethrown yet
+    std::mutex mutex;
+    std::condition_variable changed; // signalled on new jobs, finished jobs and stopping
+    std::thread thread;
+
+    void run();
+    void rethrow(); // expects the mutex to be held
+};
+
+#endif // IOWORKER_HPP
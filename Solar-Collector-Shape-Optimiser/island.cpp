@@ -0,0 +1,223 @@
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <iostream>
+
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <Solar-Collector-Shape-Optimiser/island.hpp>
+
+namespace {
+
+bool isUnix(const std::string& address) {
+    return address.rfind("unix:", 0) == 0;
+}
+
+// socket for `address`, bound and listening or connected to it
+int openSocket(const std::string& address, const bool listening) {
+    if (isUnix(address)) {
+        const std::string path = address.substr(5);
+        sockaddr_un addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+            throw std::runtime_error("Invalid Unix socket path: " + address);
+        }
+        std::memcpy(addr.sun_path, path.c_str(), path.size());
+
+        const int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) {
+            throw std::runtime_error("Could not create a socket for " + address + " (" + std::strerror(errno) + ")");
+        }
+        if (listening) {
+            // a socket file of a live island accepts connections; one left over by an island that crashed refuses them
+            const int probe = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            const int connected = probe < 0 ? -1 : ::connect(probe, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+            const int error = errno;
+            if (probe >= 0) {
+                ::close(probe);
+            }
+            if (connected == 0) {
+                ::close(fd);
+                throw std::runtime_error("Could not listen on " + address + " (another island is listening there)");
+            }
+            if (error == ECONNREFUSED) {
+                ::unlink(path.c_str());
+            }
+            else if (error != ENOENT) {
+                ::close(fd);
+                throw std::runtime_error("Could not listen on " + address + " (" + std::strerror(error) + ")");
+            }
+        }
+        const int ret = listening ? ::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr))
+                                  : ::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr));
+        if (ret != 0 || (listening && ::listen(fd, 16) != 0)) {
+            const std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Could not " + std::string(listening ? "listen on " : "connect to ") + address + " (" + error + ")");
+        }
+        return fd;
+    }
+
+    if (address.rfind("tcp:", 0) != 0) {
+        throw std::runtime_error("Island addresses are unix:<path> or tcp:<host>:<port>, got: " + address);
+    }
+    const size_t colon = address.rfind(':');
+    std::string host = address.substr(4, colon - 4);
+    const std::string port = address.substr(colon + 1);
+    if (host.size() >= 2 && host.front() == '[' && host.back() == ']') {
+        host = host.substr(1, host.size() - 2); // [IPv6]
+    }
+    if (colon < 4 || host.empty() || port.empty()) {
+        throw std::runtime_error("Invalid TCP address: " + address);
+    }
+
+    addrinfo hints;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = listening ? AI_PASSIVE : 0;
+    addrinfo* results = nullptr;
+    const int gai = ::getaddrinfo(host.c_str(), port.c_str(), &hints, &results);
+    if (gai != 0) {
+        throw std::runtime_error("Could not resolve " + address + " (" + ::gai_strerror(gai) + ")");
+    }
+
+    std::string error = "no address";
+    int fd = -1;
+    for (const addrinfo* ai = results; ai != nullptr && fd < 0; ai = ai->ai_next) {
+        fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd < 0) {
+            error = std::strerror(errno);
+            continue;
+        }
+        const int reuse = 1;
+        if (listening) {
+            ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        const int ret = listening ? ::bind(fd, ai->ai_addr, ai->ai_addrlen) : ::connect(fd, ai->ai_addr, ai->ai_addrlen);
+        if (ret != 0 || (listening && ::listen(fd, 16) != 0)) {
+            error = std::strerror(errno);
+            ::close(fd);
+            fd = -1;
+        }
+    }
+    ::freeaddrinfo(results);
+    if (fd < 0) {
+        throw std::runtime_error("Could not " + std::string(listening ? "listen on " : "connect to ") + address + " (" + error + ")");
+    }
+    return fd;
+}
+
+// a peer that stops sending or reading mid-message can't block an island for longer than this
+void setTimeout(const int fd, const int option, const int seconds) {
+    timeval timeout{seconds, 0};
+    ::setsockopt(fd, SOL_SOCKET, option, &timeout, sizeof(timeout));
+}
+
+} // namespace
+
+Island::Island(const std::string& listen_address, const std::string& send_to)
+    : listen_address(listen_address)
+    , send_to(send_to)
+    , listener(openSocket(listen_address, true))
+    , stopping(false)
+    , mutex()
+    , inbox()
+    , thread(&Island::run, this)
+{}
+
+Island::~Island() {
+    stopping = true;
+    thread.join();
+    ::close(listener);
+    if (isUnix(listen_address)) {
+        ::unlink(listen_address.substr(5).c_str());
+    }
+}
+
+void Island::send(const std::vector<char>& message) const {
+    const int fd = openSocket(send_to, false);
+    setTimeout(fd, SO_SNDTIMEO, 30);
+
+    const char* bytes = message.data();
+    size_t count = message.size();
+    while (count > 0) {
+        // (MSG_NOSIGNAL: a neighbour that went away is an error, not a SIGPIPE)
+        const ssize_t sent = ::send(fd, bytes, count, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR)
+                continue;
+            const std::string error = std::strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("Error sending to " + send_to + " (" + error + ")");
+        }
+        bytes += sent;
+        count -= sent;
+    }
+    ::close(fd);
+}
+
+std::vector<std::vector<char> > Island::receive() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<std::vector<char> > ret;
+    ret.swap(inbox);
+    return ret;
+}
+
+// accepts one connection at a time and reads it to the end (checks for stopping every 200 ms)
+void Island::run() {
+    while (!stopping) {
+        pollfd pfd{listener, POLLIN, 0};
+        if (::poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        const int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            continue;
+        }
+        setTimeout(fd, SO_RCVTIMEO, 30);
+
+        // (only this thread fills the inbox, so it can't become full before the message is queued)
+        bool full;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            full = inbox.size() >= MAX_INBOX_MESSAGES;
+        }
+        if (full) {
+            ::close(fd);
+            std::cerr << "Warning: dropped a message on " << listen_address << ", " << MAX_INBOX_MESSAGES
+                      << " messages are already waiting" << std::endl;
+            continue;
+        }
+
+        std::vector<char> message;
+        char buffer[1 << 16];
+        bool complete = false;
+        while (message.size() <= MAX_MESSAGE_SIZE) {
+            const ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received <= 0) {
+                complete = received == 0;
+                break;
+            }
+            message.insert(message.end(), buffer, buffer + received);
+        }
+        ::close(fd);
+
+        if (!complete) {
+            std::cerr << "Warning: dropped an incomplete or oversized message on " << listen_address << std::endl;
+            continue;
+        }
+        if (message.empty()) {
+            continue; // an island starting on the same address checked that this one is alive
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        inbox.push_back(std::move(message));
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef ISLAND_HPP
+#define ISLAND_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+// endpoint of an island of the island model: independent GA processes (on one machine or several) that exchange their
+// best genomes now and then. Islands form a ring (or any other topology) by pointing `send_to` at the next one.
+// Addresses are "unix:<path>" (Unix-domain socket) or "tcp:<host>:<port>" (for listening, host can be 0.0.0.0).
+// A message is one connection carrying a checkpoint (see encodeCheckpoint); a background thread accepts and reads
+// them, so a slow or dead neighbour never stops this island - sending to it fails (and the caller carries on) until
+// it is back, ex. restarted from its own checkpoint. A Unix address that a running island listens on can't be taken over.
+class Island {
+public:
+    static constexpr size_t MAX_MESSAGE_SIZE = size_t(1) << 30;
+    // messages waiting for receive(); further ones are dropped (a flood of big messages can't exhaust the memory)
+    static constexpr size_t MAX_INBOX_MESSAGES = 16;
+
+    Island(const std::string& listen_address, const std::string& send_to);
+    Island(const Island&) = delete;
+    Island& operator=(const Island&) = delete;
+    ~Island();
+
+    // sends one message to the neighbour (blocking - meant for the IoWorker), throws if it can't be delivered
+    void send(const std::vector<char>& message) const;
+    // messages received since the last call, oldest first
+    std::vector<std::vector<char> > receive();
+
+    const std::string listen_address;
+    const std::string send_to;
+
+private:
+    int listener;
+    std::atomic<bool> stopping;
+    std::mutex mutex; // inbox
+    std::vector<std::vector<char> > inbox;
+    std::thread thread;
+
+    void run();
+};
+
+#endif // ISLAND_HPP
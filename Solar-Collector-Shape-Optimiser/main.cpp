@@ -5,6 +5,10 @@
 #include <algorithm>
 #include <random>
 #include <chrono>
+#include <memory>
+#include <filesystem>
+#include <numeric>
+#include <array>
 
 #ifndef NO_STD_EXECUTION
     #include <execution>
@@ -13,8 +17,17 @@
 #endif // NO_STD_EXECUTION
 
 #include <Solar-Collector-Shape-Optimiser/solarcollector.hpp>
+#include <Solar-Collector-Shape-Optimiser/mesharena.hpp>
+#include <Solar-Collector-Shape-Optimiser/shadowtable.hpp>
+#include <Solar-Collector-Shape-Optimiser/acceptancemap.hpp>
+#include <Solar-Collector-Shape-Optimiser/fitnesscache.hpp>
+#include <Solar-Collector-Shape-Optimiser/hash.hpp>
+#include <Solar-Collector-Shape-Optimiser/checkpoint.hpp>
+#include <Solar-Collector-Shape-Optimiser/ioworker.hpp>
 #include <Solar-Collector-Shape-Optimiser/config.hpp>
 #include <Solar-Collector-Shape-Optimiser/stats.hpp>
+#include <Solar-Collector-Shape-Optimiser/trace.hpp>
+#include <Solar-Collector-Shape-Optimiser/island.hpp>
 
 
 void findProperHmaxDist (const uint32_t xsize, const uint32_t ysize, const uint32_t hmax, const Mesh3d* obs);
@@ -43,6 +56,11 @@ int main (int argc, char** argv)
     const double crossover_bias       = Config::crossover_bias;
     const double mutation_probability = Config::mutation_probability;
     const double mutation_range       = Config::mutation_range;
+    const double gene_resolution      = Config::gene_resolution;
+    const double control_spacing      = Config::encoding == "bspline" ? Config::control_spacing : 0.0; // 0: heightmap encoding
+    // B-spline control points along each side - counted on the full grid once, every stage covers the same area
+    const uint32_t control_xsize = control_spacing > 0.0 ? SolarCollector::controlCount(xsize - 1.0, control_spacing) : 0;
+    const uint32_t control_ysize = control_spacing > 0.0 ? SolarCollector::controlCount(ysize - 1.0, control_spacing) : 0;
 
     const double termination_ratio = Config::termination_ratio;
 
@@ -53,18 +71,44 @@ int main (int argc, char** argv)
 
     const std::vector<vertex> rays = Config::rays; 
 
-    const std::string obs_load_time = "1.ObstacleLoad";
-    const std::string populating_time = "2.Populating";
-    const std::string fitness_comp_time = "1.FitnessComp";
-    const std::string crossover_and_mutate_time = "2.CrossMut";
-    const std::string export_time = "3.Export";
-    const std::string checkpoint_time = "4.Checkpoint";
+    // grids optimised one after another (coarse to fine): each has about half the heights per side of the next one and
+    // covers the same area, the last one is the full xsize x ysize grid
+    struct grid_stage {
+        uint32_t xsize, ysize;
+        double xspacing, yspacing; // mm between heights
+    };
+    std::vector<grid_stage> stages;
+    for (uint32_t level = Config::coarse_levels + 1; level-- > 0; ) {
+        const uint32_t xs = std::max(2u, ((xsize - 1) >> level) + 1);
+        const uint32_t ys = std::max(2u, ((ysize - 1) >> level) + 1);
+        if (stages.empty() || stages.back().xsize != xs || stages.back().ysize != ys) {
+            stages.push_back({xs, ys, (xsize - 1.0) / (xs - 1), (ysize - 1.0) / (ys - 1)});
+        }
+    }
+    uint32_t stage = 0;
+
+    const stat_id obs_load_time = Stats::timer("1.ObstacleLoad");
+    const stat_id populating_time = Stats::timer("2.Populating");
+    const stat_id fitness_comp_time = Stats::timer("1.FitnessComp");
+    const stat_id crossover_and_mutate_time = Stats::timer("2.CrossMutFit"); // offspring are evaluated as soon as they're bred
+    const stat_id export_time = Stats::timer("3.Export");
+    const stat_id checkpoint_time = Stats::timer("4.Checkpoint");
+    if (Config::perf_counters) {
+        Stats::enablePerfCounters(Config::perf_vector_event);
+    }
+    // timeline of the threads (phases, fitness of every individual, breeding, I/O), dumped every trace_every generations
+    if (Config::trace_every > 0) {
+        Trace::enable(Config::trace_buffer_size);
+        Trace::nameThread("main");
+    }
 
     uint32_t generation = 0;  // number of current generation
 
-
-    std::random_device rd;
-    std::mt19937 mt(rd());
+    // everything random in a run derives from one seed (print it so the run can be repeated with seed=...)
+    uint64_t seed = Config::seed; // (or the seed of the run being resumed, see below)
+    std::cerr << "Seed: " << seed << std::endl;
+    std::seed_seq seed_seq{uint32_t(seed), uint32_t(seed >> 32)};
+    std::mt19937 mt(seed_seq);
     std::uniform_real_distribution<double> hdist(0.0, 0.45);//(double)hmax); // educated guess? for example take the average of 20 runs with same settings, and increment denominator. find best place to start
     // std::uniform_real_distribution<double> hdist(0.0, (double)hmax); // educated guess? for example take the average of 20 runs with same settings, and increment denominator. find best place to start
 
@@ -73,24 +117,120 @@ int main (int argc, char** argv)
     const Mesh3d obs("./obstacleBin.stl", (xsize-1.0)/2.0, (hmax-1.0)/2.0);
     // obs.exportBinarySTL("obstacleBin2.stl");
 
+    // shadows of the obstacle only depend on the rays, so they're looked up instead of traced for every individual
+    const std::unique_ptr<const ShadowTable> shadows = Config::shadow_table_resolution > 0.0 
+                                                     ? std::make_unique<const ShadowTable>(obs, rays, Config::shadow_table_resolution) 
+                                                     : nullptr;
+    // so do the directions in which reflected rays hit it (optional, approximate)
+    const std::unique_ptr<const AcceptanceMap> acceptance = Config::acceptance_resolution > 0 
+                                                          ? std::make_unique<const AcceptanceMap>(obs, xsize, ysize, hmax, Config::acceptance_cell_size, 
+                                                                                                  Config::acceptance_layers, Config::acceptance_resolution) 
+                                                          : nullptr;
+
+    // key of everything a fitness depends on besides the dna - individuals evaluated for a different key are re-evaluated
+    uint64_t setup_key = hashBytes(rays.data(), rays.size() * sizeof(vertex));
+    for (const std::vector<real_t>* field : {&obs.v0x, &obs.v0y, &obs.v0z, &obs.v1x, &obs.v1y, &obs.v1z, &obs.v2x, &obs.v2y, &obs.v2z}) {
+        setup_key = hashBytes(field->data(), field->size() * sizeof(real_t), setup_key);
+    }
+    const uint32_t shape_size[3] = {xsize, ysize, hmax};
+    setup_key = hashBytes(shape_size, sizeof(shape_size), setup_key);
+    if (acceptance) { // approximate - results depend on its settings
+        const double acceptance_settings[3] = {double(Config::acceptance_resolution), Config::acceptance_cell_size, double(Config::acceptance_layers)};
+        setup_key = hashBytes(acceptance_settings, sizeof(acceptance_settings), setup_key);
+    }
+    // ... and of the grid of a stage (the same control points of the B-spline encoding give another fitness on every grid)
+    auto stageKey = [&](const uint32_t s) {
+        const double grid[4] = {double(stages[s].xsize), double(stages[s].ysize), stages[s].xspacing, stages[s].yspacing};
+        return hashBytes(grid, sizeof(grid), setup_key) | 1; // 0 means 'not evaluated'
+    };
+    uint64_t eval_key = stageKey(stage); // of the current stage
+
+    // fitness of recently seen dna, so that duplicates aren't traced again
+    const std::unique_ptr<FitnessCache> fitness_cache = Config::fitness_cache_size > 0 
+                                                      ? std::make_unique<FitnessCache>(Config::fitness_cache_size) 
+                                                      : nullptr;
+
+    // computes the fitness of an individual, or takes it from the cache (entries of other stages don't match)
+    auto evaluate = [&](SolarCollector& pop) {
+        const uint64_t dna_hash = fitness_cache ? hashBytes(&eval_key, sizeof(eval_key), pop.hashShape()) : 0;
+        double known_fitness;
+        if (fitness_cache && fitness_cache->find(dna_hash, known_fitness)) {
+            pop.adoptFitness(known_fitness, eval_key);
+            return;
+        }
+
+        pop.computeFitness(rays, shadows.get(), acceptance.get());
+        pop.evaluated_for = eval_key;
+        if (fitness_cache) {
+            fitness_cache->insert(dna_hash, pop.fitness);
+        }
+    };
+
     Stats::end(obs_load_time); 
     Stats::begin(populating_time);
 
     // findProperHmaxDist(xsize, ysize, hmax, &obs);
 
+    // shape data of the whole population in one block (each individual keeps its slot for the whole run)
+    const bool use_arena = Config::mesh_storage == "arena";
+    MeshArena arena(use_arena ? popsize : 0, (xsize-1)*(ysize-1)*2); // big enough for every stage
+    auto storage = [&](const uint32_t i) { return use_arena ? arena.slot(i) : shape_view(); };
+
+    // resume from the binary checkpoint if there is one (else from legacy per-genome text checkpoints)
+    const std::string checkpoint_file = "./checkpoint/population.ckpt";
+    std::unique_ptr<const CheckpointFile> checkpoint;
+    if (start_from_checkpoint && std::filesystem::exists(checkpoint_file)) {
+        try {
+            checkpoint = std::make_unique<const CheckpointFile>(checkpoint_file);
+            const checkpoint_header& header = checkpoint->header();
+            // the stage the checkpoint was written in (see SolarCollector's constructor for the size) - control points
+            // are the same in every stage, those are told apart by the key of the stage (else resume on the finest grid)
+            auto dna_size = [&](const grid_stage& g) { 
+                return control_spacing > 0.0 ? control_xsize * control_ysize : (g.xsize-1)*(g.ysize-1)*2; 
+            };
+            auto resumed = std::find_if(stages.rbegin(), stages.rend(), [&](const grid_stage& g) { 
+                return header.dna_size == dna_size(g) && header.config_hash == stageKey(&g - stages.data()); 
+            });
+            if (resumed == stages.rend()) {
+                resumed = std::find_if(stages.rbegin(), stages.rend(), [&](const grid_stage& g) { return header.dna_size == dna_size(g); });
+            }
+            if (resumed == stages.rend()) {
+                throw std::runtime_error("Checkpoint DNA size mismatch. Expected: " + std::to_string(dna_size(stages.back())) + ", got: " + std::to_string(header.dna_size));
+            }
+            stage = stages.rend() - resumed - 1;
+            eval_key = stageKey(stage);
+            generation = header.generation;
+            seed = header.seed;
+            std::cerr << "Resuming generation " << generation << " of the run with seed " << seed << std::endl;
+            if (header.config_hash != eval_key) {
+                std::cerr << "Warning: rays, obstacle or shape changed since the checkpoint, the population will be re-evaluated" << std::endl;
+            }
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Checkpoint error: " << e.what() << std::endl;
+            checkpoint.reset();
+        }
+    }
+
     // create a population and a pointer to each index
     std::vector<SolarCollector> population;
     std::vector<uint32_t> pop_idx;
-    bool start_from_checkpoint_noerror = true; // if error is encountered upon reading from file ignore the rest
+    bool start_from_checkpoint_noerror = !checkpoint; // if error is encountered upon reading from file ignore the rest
     // reserve space to avoid reallocations
     population.reserve(popsize); 
     pop_idx.reserve(popsize); 
     for (uint32_t i = 0; i < popsize; i++) {
-        if (start_from_checkpoint && start_from_checkpoint_noerror) {
+        if (checkpoint && i < checkpoint->header().genome_count) {
+            population.emplace_back(stages[stage].xsize, stages[stage].ysize, hmax, &obs, storage(i), gene_resolution, 
+                                    stages[stage].xspacing, stages[stage].yspacing, control_spacing, control_xsize, control_ysize);
+            checkpoint->restore(i, population[i]);
+        }
+        else if (start_from_checkpoint && start_from_checkpoint_noerror) {
             try {
-                const Genome temp_g = deserializeFromFile("./checkpoint/" + std::to_string(i) + ".genome");
-                population.emplace_back(xsize, ysize, hmax, &obs, temp_g);
+                population.emplace_back(stages[stage].xsize, stages[stage].ysize, hmax, &obs, storage(i), gene_resolution, 
+                                    stages[stage].xspacing, stages[stage].yspacing, control_spacing, control_xsize, control_ysize);
+                deserializeFromFile("./checkpoint/" + std::to_string(i) + ".genome", population[i]);
             } catch (const std::runtime_error& e) {
+                population.pop_back();
                 std::cerr << "Deserialization error: " << e.what() << std::endl;
                 // set the flag to ignore the rest of serialized Genomes
                 start_from_checkpoint_noerror = false;
@@ -101,18 +241,45 @@ int main (int argc, char** argv)
             }
         }
         else {
-            population.emplace_back(xsize, ysize, hmax, &obs);
-            for (uint32_t k = 0; k < xsize*ysize; k++)
-                population[i].setXY(k, 0, hdist(mt));
+            population.emplace_back(stages[stage].xsize, stages[stage].ysize, hmax, &obs, storage(i), gene_resolution, 
+                                    stages[stage].xspacing, stages[stage].yspacing, control_spacing, control_xsize, control_ysize);
+            for (uint32_t k = 0; k < population[i].shapeGenes(); k++)
+                population[i].setGene(k, hdist(mt));
         }
         population[i].computeMesh();
         // populate pop_idx with indices (from 0 to population)
         pop_idx.push_back(i); 
     }
+    // continue with the same ranking (ties in fitness would otherwise be sorted differently than without the restart)
+    if (checkpoint && checkpoint->header().genome_count == popsize) {
+        pop_idx = checkpoint->ranking();
+    }
+    checkpoint.reset();
+
+    // weak individuals (positions in pop_idx) replaced every generation
+    const uint32_t survivors = popsize * (1 - termination_ratio);
+    std::vector<uint32_t> offspring_slots(popsize - survivors);
+    std::iota(offspring_slots.begin(), offspring_slots.end(), survivors);
+
+    std::filesystem::create_directories("./checkpoint");
+
+    // island model: this population is one of several (separate processes, each with its own seed and working
+    // directory) that trade their best individuals every migration_every generations (it outlives the IoWorker, whose
+    // jobs send the emigrants)
+    std::unique_ptr<Island> island;
+    if (!Config::island_listen.empty()) {
+        try {
+            island = std::make_unique<Island>(Config::island_listen, Config::island_send_to);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Island error: " << e.what() << std::endl;
+            return 1;
+        }
+        std::cerr << "Island listening on " << island->listen_address
+                  << (island->send_to.empty() ? "" : ", migrating to " + island->send_to) << std::endl;
+    }
 
-    // create a vector for future parents
-    std::vector<uint32_t> parents;
-    parents.reserve(2);
+    // checkpoints and exports are written in the background from snapshots, while the next generations are computed
+    IoWorker io(Config::io_queue_size);
 
     // format text for CSV integration
     std::cout << "Gen";
@@ -123,31 +290,101 @@ int main (int argc, char** argv)
 
     Stats::end(populating_time); Stats::show(); Stats::clear();
 
-    while (true)
-    {
+    // individuals not evaluated for the current setup - the initial population, including individuals restored from
+    // a checkpoint or resampled onto a finer grid (offspring are evaluated right after breeding, see below)
+    // computeFitness is parallel itself (nested tasks), so only 'par' - it can't run under an unsequenced policy
+    auto evaluatePopulation = [&]() {
         Stats::begin(fitness_comp_time);
-
         #ifndef NO_STD_EXECUTION
-            std::for_each(std::execution::par_unseq, population.begin(), population.end(), [&](auto& pop) {
-                if (pop.fitness == 0) {
-                    pop.computeFitness(rays);
+            std::for_each(std::execution::par, population.begin(), population.end(), [&](auto& pop) {
+                if (pop.evaluated_for != eval_key) {
+                    TraceSpan span("Evaluate", "slot", &pop - population.data());
+                    evaluate(pop);
                 }
             });
         #else 
-            #pragma omp parallel for
+            #pragma omp parallel
+            #pragma omp single
+            #pragma omp taskloop grainsize(1)
             for (size_t i = 0; i < population.size(); ++i) {
-                if (population[i].fitness == 0) {
-                    population[i].computeFitness(rays);
+                if (population[i].evaluated_for != eval_key) {
+                    TraceSpan span("Evaluate", "slot", i);
+                    evaluate(population[i]);
                 }
             }
         #endif // NO_STD_EXECUTION
-
         Stats::end(fitness_comp_time);
 
         // sorted best to worst using indices
         sort(pop_idx.begin(), pop_idx.end(), [&](const uint32_t a, const uint32_t b) {
             return population[a].fitness > population[b].fitness; // Sort in descending order of fitness
         });
+    };
+
+    // best fitness of the current stage and the number of generations since it last improved
+    double stage_best = 0.0;
+    uint32_t stage_stale = 0;
+
+    while (true)
+    {
+        TraceSpan generation_span("Generation", "generation", generation);
+        evaluatePopulation();
+
+        // immigrants (best first) replace the weakest individuals - never more than are replaced by offspring anyway,
+        // so the survivors of this island stay; they are evaluated here
+        if (island) {
+            uint32_t replaced = 0;
+            for (const std::vector<char>& message : island->receive()) {
+                try {
+                    const CheckpointView migrants(message.data(), message.size(), "migration");
+                    if (migrants.header().dna_size != population[0].dna_size) {
+                        continue; // sent from another stage of the coarse to fine grids
+                    }
+                    for (const uint32_t idx : migrants.ranking()) {
+                        if (replaced == popsize - survivors)
+                            break;
+                        SolarCollector& pop = population[pop_idx[popsize - 1 - replaced]];
+                        migrants.restore(idx, pop);
+                        // the fitness comes from a peer and the slot's per-triangle results from its previous genome
+                        pop.adoptFitness(0.0, 0);
+                        pop.computeMesh();
+                        ++replaced;
+                    }
+                } catch (const std::runtime_error& e) {
+                    std::cerr << "Warning: ignored migrants (" << e.what() << ")" << std::endl;
+                }
+            }
+            if (replaced > 0) {
+                std::cerr << "Generation " << generation << ": " << replaced << " immigrants" << std::endl;
+                evaluatePopulation();
+            }
+        }
+
+        // a coarse stage ends when its best individual stops improving: the population is resampled onto the next finer
+        // grid (same slots, same ranking) and evaluated there
+        if (stage + 1 < stages.size()) {
+            if (population[pop_idx[0]].fitness > stage_best) {
+                stage_best = population[pop_idx[0]].fitness;
+                stage_stale = 0;
+            } else if (++stage_stale >= Config::stage_patience) {
+                ++stage;
+                stage_best = 0.0;
+                stage_stale = 0;
+                std::cerr << "Generation " << generation << ": continuing on a " << stages[stage].xsize << "x" << stages[stage].ysize 
+                          << " grid" << std::endl;
+
+                std::vector<SolarCollector> finer;
+                finer.reserve(popsize);
+                for (uint32_t i = 0; i < popsize; i++) {
+                    finer.emplace_back(stages[stage].xsize, stages[stage].ysize, hmax, &obs, storage(i), gene_resolution, 
+                                       stages[stage].xspacing, stages[stage].yspacing, control_spacing, control_xsize, control_ysize);
+                    finer[i].resampleFrom(population[i]);
+                }
+                population.swap(finer);
+                eval_key = stageKey(stage);
+                evaluatePopulation();
+            }
+        }
 
         // print fitness for every SolarCollector
         std::cout << std::to_string(generation);
@@ -158,19 +395,39 @@ int main (int argc, char** argv)
 
         Stats::begin(crossover_and_mutate_time);
 
-        // replace weak indivituals
-        for (uint32_t i = popsize * (1 - termination_ratio); i < popsize; ++i) {
-            // Clear parents 
-            parents.clear(); 
-            // Select two random parents from the *top* 1-termination_ratio of the population.
-            std::sample(pop_idx.begin(), pop_idx.begin() + (popsize * (1 - termination_ratio)), std::back_inserter(parents), 2, mt);
-
-            // Create an offspring using the selected parents.
-            const Genome offspring(population[parents[0]], population[parents[1]], crossover_bias, mutation_probability, mutation_range);
+        // Replace the weak individuals with offspring of two random parents from the *top* 1-termination_ratio of the
+        // population (in place - no allocations), each as its own task.
+        // Every offspring draws from its own stream (seed, generation, slot), so the result doesn't depend on the order of
+        // breeding and the seed and generation are the whole random state of a run. Offspring are evaluated right away
+        // (nested tasks), so evaluation of the first offspring overlaps breeding of the others.
+        // Parents are survivors - they're neither bred nor evaluated here.
+        auto makeOffspring = [&](const uint32_t i) {
+            RngStream rng(seed, (uint64_t(generation) << 32) | i);
+
+            // two distinct parents
+            const uint32_t first = std::min(uint32_t(rng.uniform() * survivors), survivors - 1);
+            uint32_t second = std::min(uint32_t(rng.uniform() * (survivors - 1)), survivors - 1);
+            second = survivors > 1 && second >= first ? second + 1 : second;
+
+            SolarCollector& offspring = population[pop_idx[i]];
+            {
+                TraceSpan span("Breed", "slot", pop_idx[i]);
+                offspring.breed(population[pop_idx[first]], population[pop_idx[second]], crossover_bias, mutation_probability, mutation_range, rng);
+            }
+            TraceSpan span("Evaluate", "slot", pop_idx[i]);
+            evaluate(offspring);
+        };
 
-            // Replace the weak individual (at pop_idx[i]) with the new offspring.
-            population[pop_idx[i]] = SolarCollector(xsize, ysize, hmax, &obs, offspring);
-        }
+        #ifndef NO_STD_EXECUTION
+            std::for_each(std::execution::par, offspring_slots.begin(), offspring_slots.end(), makeOffspring);
+        #else 
+            #pragma omp parallel
+            #pragma omp single
+            #pragma omp taskloop grainsize(1)
+            for (size_t k = 0; k < offspring_slots.size(); ++k) {
+                makeOffspring(offspring_slots[k]);
+            }
+        #endif // NO_STD_EXECUTION
          
         Stats::end(crossover_and_mutate_time);
 
@@ -178,7 +435,13 @@ int main (int argc, char** argv)
         // export the best from the population once in a while
         if (!(generation % export_every)) {
             Stats::begin(export_time);
-            population[pop_idx[0]].exportAsBinarySTL("Gen" + std::to_string(generation) + "Fit" + std::to_string(int(population[pop_idx[0]].fitness)) + ".stl");
+            // snapshot of the heights, the mesh is built by the writer
+            auto best = std::make_shared<const SolarCollector>(population[pop_idx[0]]);
+            const std::string name = "Gen" + std::to_string(generation) + "Fit" + std::to_string(int(best->fitness)) + ".stl";
+            io.submit([best, name, generation] {
+                TraceSpan span("ExportSTL", "generation", generation);
+                best->exportAsBinarySTL(name);
+            });
             Stats::end(export_time);
 
         }
@@ -188,12 +451,50 @@ int main (int argc, char** argv)
         // make a checkpoint of current population AFTER ++gen so that gen0 isn't checkpointed (huge QOL :))
         if (!(generation % checkpoint_every)) {
             Stats::begin(checkpoint_time);
-            for (uint32_t i = 0 ; i < popsize; ++i) {
-                serializeToFile(population[pop_idx[i]], "./checkpoint/" + std::to_string(i) + ".genome");
-            }
+            // snapshot in index order (same slots after a restart)
+            auto snapshot = std::make_shared<const std::vector<Genome> >(population.begin(), population.end());
+            io.submit([snapshot, &checkpoint_file, ranking = pop_idx, generation, seed, eval_key] {
+                TraceSpan span("WriteCheckpoint", "generation", generation);
+                std::vector<const Genome*> genomes;
+                for (const Genome& genome : *snapshot) {
+                    genomes.push_back(&genome);
+                }
+                writeCheckpoint(checkpoint_file, genomes, ranking, generation, seed, eval_key);
+            });
             Stats::end(checkpoint_time); 
         }
 
+        // emigrants: copies of the best individuals, sent to the next island in the background (a neighbour that's down
+        // only costs a warning, it gets the next ones)
+        if (island && !island->send_to.empty() && !(generation % Config::migration_every)) {
+            const uint32_t count = std::min(Config::migration_size, popsize);
+            auto emigrants = std::make_shared<std::vector<Genome> >();
+            for (uint32_t i = 0; i < count; i++) {
+                emigrants->push_back(population[pop_idx[i]]);
+            }
+            io.submit([emigrants, island = island.get(), generation, seed, eval_key] {
+                TraceSpan span("Migrate", "generation", generation);
+                std::vector<const Genome*> genomes;
+                std::vector<uint32_t> ranking;
+                for (const Genome& genome : *emigrants) {
+                    ranking.push_back(genomes.size());
+                    genomes.push_back(&genome);
+                }
+                try {
+                    island->send(encodeCheckpoint(genomes, ranking, generation, seed, eval_key));
+                } catch (const std::runtime_error& e) {
+                    std::cerr << "Warning: migration failed (" << e.what() << ")" << std::endl;
+                }
+            });
+        }
+
+        // timeline of the recent generations (as much as the threads' buffers hold), written in the background
+        if (Config::trace_every > 0 && !(generation % Config::trace_every)) {
+            auto threads = std::make_shared<const std::vector<trace_thread> >(Trace::snapshot());
+            const std::string name = "TraceGen" + std::to_string(generation) + ".json";
+            io.submit([threads, name] { Trace::writeChromeJson(*threads, name); });
+        }
+
         // if (generation == 3) return 0;
         Stats::show();
 
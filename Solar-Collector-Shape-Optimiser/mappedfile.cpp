@@ -0,0 +1,51 @@
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <Solar-Collector-Shape-Optimiser/mappedfile.hpp>
+
+MappedFile::MappedFile(const std::string& filename)
+    : bytes(nullptr)
+    , length(0)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file for reading: " + filename + " (" + std::strerror(errno) + ")");
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        const std::string error = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("Could not stat file: " + filename + " (" + error + ")");
+    }
+    length = st.st_size;
+    if (length == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping stays valid
+    if (mapping == MAP_FAILED) {
+        throw std::runtime_error("Could not map file: " + filename + " (" + std::strerror(errno) + ")");
+    }
+    bytes = static_cast<const char*>(mapping);
+}
+
+MappedFile::~MappedFile() {
+    if (bytes != nullptr) {
+        ::munmap(const_cast<char*>(bytes), length);
+    }
+}
+
+void MappedFile::prefetch() const {
+    if (bytes != nullptr) {
+        ::madvise(const_cast<char*>(bytes), length, MADV_WILLNEED);
+    }
+}
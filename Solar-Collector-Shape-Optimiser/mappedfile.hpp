@@ -0,0 +1,25 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// read-only memory mapping of a whole file (pages are read on demand by the OS, no copy into a buffer)
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return bytes; }
+    size_t size() const { return length; }
+    // asks the OS to start reading the whole file in (it's about to be read by several threads at once)
+    void prefetch() const;
+
+private:
+    const char* bytes; // nullptr for empty files (they can't be mapped)
+    size_t length;
+};
+
+#endif // MAPPEDFILE_HPP
@@ -1,13 +1,16 @@
 #include <algorithm>
 #include <cmath>
-#include <fstream>
-#include <sstream>
-#include <iostream>
 #include <cstring>
+#include <charconv>
+#include <string_view>
+#include <stdexcept>
 #include <execution>
 #include <ranges>
+#include <numeric>
 
 #include <Solar-Collector-Shape-Optimiser/mesh3d.hpp>
+#include <Solar-Collector-Shape-Optimiser/filewriter.hpp>
+#include <Solar-Collector-Shape-Optimiser/mappedfile.hpp>
 
 
 Mesh3d::Mesh3d() 
@@ -27,12 +30,13 @@ Mesh3d::Mesh3d(const uint32_t triangle_count)
 
 // Constructor from file (STL)
 Mesh3d::Mesh3d(const std::string filename, const double xmove, const double ymove)
-    : Mesh3d(importBinarySTL(filename)) {  
+    : Mesh3d(loadSTL(filename)) {  
     if (xmove != 0.0 && ymove != 0.0)
         moveXY(xmove, ymove);
     findCircumcentres();
     findEdges();
     findBoundingBox();
+    buildBVH();
 }
 
 Mesh3d::~Mesh3d() {}
@@ -40,8 +44,8 @@ Mesh3d::~Mesh3d() {}
 void Mesh3d::moveXY(const double& x, const double& y) {
 
     // Apply the translation to all x and y components of vertices and midpoints.
-    auto translate_x = [x](double& val) { val += x; };
-    auto translate_y = [y](double& val) { val += y; };
+    auto translate_x = [x](real_t& val) { val += x; };
+    auto translate_y = [y](real_t& val) { val += y; };
 
     #ifndef NO_STD_EXECUTION
 
@@ -84,72 +88,54 @@ void Mesh3d::moveXY(const double& x, const double& y) {
 }
 
 void Mesh3d::exportSTL(const std::string& filename) const {
-    std::ofstream stlout(filename, std::ofstream::trunc); // open file in a constructor, will be closed by destructor
-    std::stringstream stlmem; // Build the entire string in memory
+    FileWriter stlout(filename); // streamed through a fixed-size buffer
 
-    stlmem << std::scientific << "solid Mesh3d" << std::endl;
+    auto writeVector = [&](const char* prefix, const size_t prefix_size, const double x, const double y, const double z) {
+        stlout.write(prefix, prefix_size);
+        stlout.writeScientific(x); stlout.write(" ", 1);
+        stlout.writeScientific(y); stlout.write(" ", 1);
+        stlout.writeScientific(z); stlout.write("\n", 1);
+    };
+    static constexpr char facet[] = "  facet normal ";
+    static constexpr char loop[] = "    outer loop\n";
+    static constexpr char vert[] = "      vertex ";
+    static constexpr char endfacet[] = "    endloop\n  endfacet\n";
 
+    stlout.write(std::string("solid Mesh3d\n"));
     for (uint32_t i = 0; i < triangle_count; ++i) {
-        stlmem << "  facet normal " << normx[i] << " " << normy[i] << " " << normz[i] << std::endl;
-        stlmem << "    outer loop" << std::endl;
-        stlmem << "      vertex " << v0x[i] << " " << v0y[i] << " " << v0z[i] << std::endl;
-        stlmem << "      vertex " << v1x[i] << " " << v1y[i] << " " << v1z[i] << std::endl;
-        stlmem << "      vertex " << v2x[i] << " " << v2y[i] << " " << v2z[i] << std::endl;
-        stlmem << "    endloop" << std::endl;
-        stlmem << "  endfacet" << std::endl;
+        writeVector(facet, sizeof(facet) - 1, normx[i], normy[i], normz[i]);
+        stlout.write(loop, sizeof(loop) - 1);
+        writeVector(vert, sizeof(vert) - 1, v0x[i], v0y[i], v0z[i]);
+        writeVector(vert, sizeof(vert) - 1, v1x[i], v1y[i], v1z[i]);
+        writeVector(vert, sizeof(vert) - 1, v2x[i], v2y[i], v2z[i]);
+        stlout.write(endfacet, sizeof(endfacet) - 1);
     }
-
-    stlmem << "endsolid Mesh3d" << std::endl;
-
-    stlout << stlmem.str(); // Write the entire string at once
+    stlout.write(std::string("endsolid Mesh3d\n"));
+    stlout.close();
 }
 
 void Mesh3d::exportBinarySTL(const std::string& filename) const {
-    // Use a vector<char> as our in-memory buffer
-    std::vector<char> buffer;
-
-    // 1. Reserve space for the header (80 bytes)
-    buffer.resize(80);
-    std::strcpy(buffer.data(), "Binary STL Mesh3d"); // Add an identifier
+    FileWriter stlout(filename); // streamed through a fixed-size buffer
 
-    // 2. Calculate and reserve space for the number of triangles (4 bytes)
+    // 80 byte header, number of triangles
+    char header[80] = {};
+    std::strcpy(header, "Binary STL Mesh3d"); // Add an identifier
+    stlout.write(header, sizeof(header));
     const uint32_t numTriangles = triangle_count;
-    const size_t numTrianglesOffset = buffer.size(); // Store the offset where numTriangles will be
-    buffer.resize(buffer.size() + sizeof(numTriangles));
-    std::memcpy(buffer.data() + numTrianglesOffset, &numTriangles, sizeof(numTriangles));
+    stlout.write(&numTriangles, sizeof(numTriangles));
 
-    // 3. Reserve space for all triangle data (50 bytes per triangle)
-    const size_t triangleDataOffset = buffer.size();
-    buffer.resize(buffer.size() + (triangle_count * 50));
-    char* triangleDataPtr = buffer.data() + triangleDataOffset;
-
-    // 4. Write the triangle data to the buffer
+    // 50 bytes per triangle
     for (uint32_t i = 0; i < triangle_count; ++i) {
-        const float normal[3] = {(float)normx[i], (float)normy[i], (float)normz[i]};
-        const float v0[3] = {(float)v0x[i], (float)v0y[i], (float)v0z[i]};
-        const float v1[3] = {(float)v1x[i], (float)v1y[i], (float)v1z[i]};
-        const float v2[3] = {(float)v2x[i], (float)v2y[i], (float)v2z[i]};
+        const float record[12] = {(float)normx[i], (float)normy[i], (float)normz[i],
+                                  (float)v0x[i], (float)v0y[i], (float)v0z[i],
+                                  (float)v1x[i], (float)v1y[i], (float)v1z[i],
+                                  (float)v2x[i], (float)v2y[i], (float)v2z[i]};
         const uint16_t attributeByteCount = 0; // Usually 0
 
-        std::memcpy(triangleDataPtr, normal, sizeof(normal));
-        triangleDataPtr += sizeof(normal);
-        std::memcpy(triangleDataPtr, v0, sizeof(v0));
-        triangleDataPtr += sizeof(v0);
-        std::memcpy(triangleDataPtr, v1, sizeof(v1));
-        triangleDataPtr += sizeof(v1);
-        std::memcpy(triangleDataPtr, v2, sizeof(v2));
-        triangleDataPtr += sizeof(v2);
-        std::memcpy(triangleDataPtr, &attributeByteCount, sizeof(attributeByteCount));
-        triangleDataPtr += sizeof(attributeByteCount);
-    }
-
-    // 5. Write the entire buffer to the file
-    std::ofstream stlout(filename, std::ios::binary | std::ios::trunc);
-    if (!stlout.is_open()) {
-        std::cerr << "Error opening file for writing: " << filename << std::endl;
-        return; // Or throw an exception
+        stlout.write(record, sizeof(record));
+        stlout.write(&attributeByteCount, sizeof(attributeByteCount));
     }
-    stlout.write(buffer.data(), buffer.size());
+    stlout.close();
 }
 
 vertex xProduct(const vertex& a, const vertex& b) {
@@ -225,45 +211,8 @@ void Mesh3d::findCircumcentres() {
                   std::views::iota(0u, triangle_count).end(),
                   [this](uint32_t i) {
         // Calculate circumcenter for triangle i.
-
-        // Fetch vertices.  Use 'const' to allow the compiler to optimize more.
-        const double ax = v0x[i];
-        const double ay = v0y[i];
-        const double az = v0z[i];
-        const double bx = v1x[i];
-        const double by = v1y[i];
-        const double bz = v1z[i];
-        const double cx = v2x[i];
-        const double cy = v2y[i];
-        const double cz = v2z[i];
-
-        // Calculate intermediate values.  Minimize redundant calculations.
-        const double bax = bx - ax;
-        const double bay = by - ay;
-        const double baz = bz - az;
-        const double cax = cx - ax;
-        const double cay = cy - ay;
-        const double caz = cz - az;
-
-        const double ba_mag2 = bax * bax + bay * bay + baz * baz;
-        const double ca_mag2 = cax * cax + cay * cay + caz * caz;
-
-        // Compute cross product of (B - A) and (C - A).
-        const double cross_x = bay * caz - baz * cay;
-        const double cross_y = baz * cax - bax * caz;
-        const double cross_z = bax * cay - bay * cax;
-
-        //  Compute the denominator of the circumcenter calculation.
-        const double denom = 0.5 / (cross_x * cross_x + cross_y * cross_y + cross_z * cross_z);
-
-        // Compute circumcenter coordinates.
-        const double ox = denom * (ba_mag2 * (cay * cross_z - caz * cross_y) + ca_mag2 * (baz * cross_y - bay * cross_z));
-        const double oy = denom * (ba_mag2 * (caz * cross_x - cax * cross_z) + ca_mag2 * (bax * cross_z - baz * cross_x));
-        const double oz = denom * (ba_mag2 * (cax * cross_y - cay * cross_x) + ca_mag2 * (bay * cross_x - bax * cross_y));
-        
-        midpx[i] = ox + ax;
-        midpy[i] = oy + ay;
-        midpz[i] = oz + az;
+        triangleCircumcentre(v0x[i], v0y[i], v0z[i], v1x[i], v1y[i], v1z[i], v2x[i], v2y[i], v2z[i], 
+                             midpx[i], midpy[i], midpz[i]);
     });
 }
 
@@ -279,35 +228,8 @@ void Mesh3d::findNormals() {
                   std::views::iota(0u, triangle_count).begin(), // Use iota view
                   std::views::iota(0u, triangle_count).end(),
                   [this](uint32_t i) {
-        // Compute the vectors representing two sides of the triangle.
-        const double edge1x = v1x[i] - v0x[i];
-        const double edge1y = v1y[i] - v0y[i];
-        const double edge1z = v1z[i] - v0z[i];
-
-        const double edge2x = v2x[i] - v0x[i];
-        const double edge2y = v2y[i] - v0y[i];
-        const double edge2z = v2z[i] - v0z[i];
-
-        // Compute the cross product (normal vector).
-        const double nx = edge1y * edge2z - edge1z * edge2y;
-        const double ny = edge1z * edge2x - edge1x * edge2z;
-        const double nz = edge1x * edge2y - edge1y * edge2x;
-
-        // Normalize the normal vector.
-        const double magnitude = std::sqrt(nx * nx + ny * ny + nz * nz);
-
-        // Handle the case where the triangle is degenerate (magnitude is zero or very close to zero).
-        if (magnitude > 1e-12) // Use a small tolerance to avoid division by zero.
-        {
-            normx[i] = nx / magnitude;
-            normy[i] = ny / magnitude;
-            normz[i] = nz / magnitude;
-        } else {
-            // For degenerate triangles, set the normal to a default value (e.g., zero).
-            normx[i] = 0.0;
-            normy[i] = 0.0;
-            normz[i] = 0.0;
-        }
+        triangleNormal(v0x[i], v0y[i], v0z[i], v1x[i], v1y[i], v1z[i], v2x[i], v2y[i], v2z[i], 
+                       normx[i], normy[i], normz[i]);
     });
 }
 
@@ -365,6 +287,105 @@ void Mesh3d::findBoundingBox() {
 
 }
 
+// Builds a bounding volume hierarchy over the mesh (median split along the longest axis of triangle centroids).
+// Triangles are reordered so that every leaf references a contiguous range of them.
+void Mesh3d::buildBVH(const uint32_t max_leaf_size) {
+    bvh.clear();
+    if (triangle_count == 0) {
+        return; // Nothing to do for an empty mesh
+    }
+
+    // centroids are only used to decide where to split
+    std::vector<double> cx(triangle_count), cy(triangle_count), cz(triangle_count);
+    for (uint32_t i = 0; i < triangle_count; ++i) {
+        cx[i] = ((double)v0x[i] + v1x[i] + v2x[i]) / 3.0;
+        cy[i] = ((double)v0y[i] + v1y[i] + v2y[i]) / 3.0;
+        cz[i] = ((double)v0z[i] + v1z[i] + v2z[i]) / 3.0;
+    }
+    const std::vector<double>* centroid[3] = {&cx, &cy, &cz};
+
+    // order[k] is the index of the triangle that will be stored at position k
+    std::vector<uint32_t> order(triangle_count);
+    std::iota(order.begin(), order.end(), 0u);
+
+    bvh.reserve(2 * triangle_count);
+    bvh.emplace_back();
+    bvh[0].first = 0;
+    bvh[0].count = triangle_count;
+
+    std::vector<uint32_t> todo{0}; // nodes that still have to be bounded (and maybe split)
+    while (!todo.empty()) {
+        const uint32_t node_idx = todo.back();
+        todo.pop_back();
+
+        const uint32_t first = bvh[node_idx].first;
+        const uint32_t count = bvh[node_idx].count;
+
+        // bounding box of the node's triangles and of their centroids
+        vertex bmin(INFINITY, INFINITY, INFINITY), bmax(-INFINITY, -INFINITY, -INFINITY);
+        vertex cmin(INFINITY, INFINITY, INFINITY), cmax(-INFINITY, -INFINITY, -INFINITY);
+        for (uint32_t k = first; k < first + count; ++k) {
+            const uint32_t i = order[k];
+            bmin.x = std::min<double>({bmin.x, v0x[i], v1x[i], v2x[i]});
+            bmin.y = std::min<double>({bmin.y, v0y[i], v1y[i], v2y[i]});
+            bmin.z = std::min<double>({bmin.z, v0z[i], v1z[i], v2z[i]});
+            bmax.x = std::max<double>({bmax.x, v0x[i], v1x[i], v2x[i]});
+            bmax.y = std::max<double>({bmax.y, v0y[i], v1y[i], v2y[i]});
+            bmax.z = std::max<double>({bmax.z, v0z[i], v1z[i], v2z[i]});
+            cmin.x = std::min(cmin.x, cx[i]); cmax.x = std::max(cmax.x, cx[i]);
+            cmin.y = std::min(cmin.y, cy[i]); cmax.y = std::max(cmax.y, cy[i]);
+            cmin.z = std::min(cmin.z, cz[i]); cmax.z = std::max(cmax.z, cz[i]);
+        }
+        bvh[node_idx].bbmin = bmin;
+        bvh[node_idx].bbmax = bmax;
+
+        // split along the longest axis of the centroid bounds
+        const double extent[3] = {cmax.x - cmin.x, cmax.y - cmin.y, cmax.z - cmin.z};
+        const int axis = std::distance(extent, std::max_element(extent, extent + 3));
+        if (count <= max_leaf_size || extent[axis] <= 0.0) {
+            continue; // stays a leaf
+        }
+
+        const uint32_t half = count / 2;
+        const std::vector<double>& c = *centroid[axis];
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+                         [&c](uint32_t a, uint32_t b) { return c[a] < c[b]; });
+
+        const uint32_t left_idx = bvh.size();
+        bvh.emplace_back();
+        bvh.emplace_back();
+        bvh[left_idx].first = first;
+        bvh[left_idx].count = half;
+        bvh[left_idx + 1].first = first + half;
+        bvh[left_idx + 1].count = count - half;
+        bvh[node_idx].first = left_idx;
+        bvh[node_idx].count = 0;
+
+        todo.push_back(left_idx);
+        todo.push_back(left_idx + 1);
+    }
+
+    // reorder triangles so that the leaves reference contiguous ranges
+    std::vector<real_t> tmp(triangle_count);
+    auto permute = [&](std::vector<real_t>& field) {
+        if (field.size() != triangle_count) {
+            return; // optional field that was never computed
+        }
+        for (uint32_t k = 0; k < triangle_count; ++k) {
+            tmp[k] = field[order[k]];
+        }
+        field.swap(tmp);
+    };
+    for (auto* field : {&v0x, &v0y, &v0z, &v1x, &v1y, &v1z, &v2x, &v2y, &v2z,
+                        &normx, &normy, &normz, &midpx, &midpy, &midpz,
+                        &e1x, &e1y, &e1z, &e2x, &e2y, &e2z}) {
+        permute(*field);
+    }
+
+    bbmin = bvh[0].bbmin;
+    bbmax = bvh[0].bbmax;
+}
+
 vertex calculateReflection(const vertex& normal, const vertex& ray) {
     // reflection = ray - 2 * dotProduct(ray, normal) * normal
     const double dot = dotProduct(ray, normal);
@@ -373,162 +394,314 @@ vertex calculateReflection(const vertex& normal, const vertex& ray) {
                   ray.z - 2.0 * dot * normal.z};
 }
 
-Mesh3d importSTL(const std::string& filename) {
-    std::string line;
-    std::ifstream file(filename, std::ifstream::in);
-
-    size_t pos;
-    uint32_t triangle_count;
-
-    if (!file.is_open()) return Mesh3d();
-
-    triangle_count = std::count(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>(), '\n');
-    triangle_count -= 2;
-    triangle_count /= 7;
-
-    Mesh3d ret(triangle_count);
-
-    file.seekg(0, file.beg);    // return to beginning
-    file.clear();               // clear flags (especially eof flag)
-
-    std::getline(file, line);   // skip the name of the solid
-    std::getline(file, line);   // get the "facet normal" line ready
-
-    for (int i = 0; line.find("endsolid") == std::string::npos; i++) { // read untill you find "endsolid";
-        // get normal
-        pos = line.rfind(' ');      // find last ' '
-        ret.normz[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.normy[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.normx[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-
-        std::getline(file, line);   // skip the "outer loop" line
-            
-        // vertex 0
-        std::getline(file, line);   // get the first "vertex" line ready
-        pos = line.rfind(' ');      // find last ' '
-        ret.v0z[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v0y[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v0x[i] = strtod(line.substr(pos + 1, std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-
-        // vertex 1
-        std::getline(file, line);   // get the second "vertex" line ready
-        pos = line.rfind(' ');      // find last ' '
-        ret.v1z[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v1y[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v1x[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-
-        // vertex 2
-        std::getline(file, line);   // get the third "vertex" line ready
-        pos = line.rfind(' ');      // find last ' '
-        ret.v2z[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v2y[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-        pos = line.rfind(' ');      // find last ' '
-        ret.v2x[i] = strtod(line.substr(pos+1,std::string::npos).c_str(), nullptr);
-        line = line.substr(0, pos);
-
-
-        std::getline(file, line);   // skip "endloop"
-        std::getline(file, line);   // skip "endfacet"
-
-        std::getline(file, line);   // get the "facet normal" line ready (or "endsolid" line)
-        
+// runs fn(c) for every chunk c < chunk_count in parallel; the first error is rethrown after all chunks are done
+// (exceptions can't escape parallel algorithms)
+template <typename Fn>
+static void forEachChunk(const size_t chunk_count, const Fn& fn) {
+    std::vector<std::string> errors(chunk_count);
+    auto guarded = [&](const size_t c) {
+        try {
+            fn(c);
+        } catch (const std::exception& e) {
+            errors[c] = e.what();
+        }
+    };
+
+    #ifndef NO_STD_EXECUTION
+        std::vector<size_t> chunks(chunk_count);
+        std::iota(chunks.begin(), chunks.end(), size_t(0));
+        std::for_each(std::execution::par, chunks.begin(), chunks.end(), guarded);
+    #else
+        #pragma omp parallel for schedule(dynamic)
+        for (size_t c = 0; c < chunk_count; ++c) {
+            guarded(c);
+        }
+    #endif // NO_STD_EXECUTION
+
+    for (const std::string& error : errors) {
+        if (!error.empty()) {
+            throw std::runtime_error(error);
+        }
+    }
+}
+
+static bool isSpace(const char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+}
+
+// keyword "facet" (not the end of "endfacet") at `p`
+static bool isFacetAt(const char* begin, const char* end, const char* p) {
+    return end - p > 5 && std::memcmp(p, "facet", 5) == 0 && (p == begin || isSpace(p[-1])) && isSpace(p[5]);
+}
+
+// ASCII STL: "solid name", per triangle "facet normal n n n / outer loop / vertex v v v (x3) / endloop / endfacet",
+// "endsolid name"
+// the text is split into chunks; facets are counted per chunk (a facet belongs to the chunk its keyword starts in), so
+// every chunk knows the index of its first triangle and parses straight into the arrays
+static Mesh3d decodeAsciiSTL(const char* begin, const char* end, const std::string& filename) {
+    constexpr size_t CHUNK_SIZE = 1 << 20;
+    const size_t size = end - begin;
+    const size_t chunk_count = (size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const std::string_view text(begin, size);
+
+    if (text.rfind("endsolid") == std::string_view::npos) {
+        throw std::runtime_error("Invalid ASCII STL " + filename + ": no 'endsolid' (truncated?)");
     }
 
+    auto forEachFacet = [&](const size_t c, const auto& fn) {
+        const size_t chunk_end = std::min(size, (c + 1) * CHUNK_SIZE);
+        for (size_t pos = text.find("facet", c * CHUNK_SIZE); pos < chunk_end; pos = text.find("facet", pos + 5)) {
+            if (isFacetAt(begin, end, begin + pos)) {
+                fn(begin + pos);
+            }
+        }
+    };
+
+    std::vector<uint32_t> first(chunk_count + 1, 0); // index of the first triangle of every chunk
+    forEachChunk(chunk_count, [&](const size_t c) {
+        uint32_t count = 0;
+        forEachFacet(c, [&](const char*) { ++count; });
+        first[c + 1] = count;
+    });
+    std::partial_sum(first.begin(), first.end(), first.begin());
+
+    Mesh3d ret(first.back());
+
+    forEachChunk(chunk_count, [&](const size_t c) {
+        uint32_t i = first[c];
+        forEachFacet(c, [&](const char* p) {
+            auto fail = [&](const std::string& what) {
+                throw std::runtime_error("Invalid ASCII STL " + filename + ": " + what + " in facet " + std::to_string(i)
+                                         + " (byte " + std::to_string(p - begin) + ")");
+            };
+            auto skipSpace = [&]() {
+                while (p < end && isSpace(*p)) {
+                    ++p;
+                }
+            };
+            auto expect = [&](const std::string_view keyword) {
+                skipSpace();
+                if (size_t(end - p) < keyword.size() || std::string_view(p, keyword.size()) != keyword 
+                    || (p + keyword.size() < end && !isSpace(p[keyword.size()]))) {
+                    fail("expected '" + std::string(keyword) + "'");
+                }
+                p += keyword.size();
+            };
+            auto number = [&]() {
+                skipSpace();
+                if (p < end && *p == '+') {
+                    ++p; // from_chars doesn't take a leading '+'
+                }
+                double value;
+                const std::from_chars_result result = std::from_chars(p, end, value);
+                if (result.ec != std::errc() || (result.ptr < end && !isSpace(*result.ptr))) {
+                    fail("invalid number");
+                }
+                p = result.ptr;
+                return real_t(value);
+            };
+
+            expect("facet"); expect("normal");
+            ret.normx[i] = number(); ret.normy[i] = number(); ret.normz[i] = number();
+            expect("outer"); expect("loop");
+            expect("vertex");
+            ret.v0x[i] = number(); ret.v0y[i] = number(); ret.v0z[i] = number();
+            expect("vertex");
+            ret.v1x[i] = number(); ret.v1y[i] = number(); ret.v1z[i] = number();
+            expect("vertex");
+            ret.v2x[i] = number(); ret.v2y[i] = number(); ret.v2z[i] = number();
+            expect("endloop");
+            expect("endfacet");
+            ++i;
+        });
+    });
+
     return ret;
 }
 
-Mesh3d importBinarySTL(const std::string& filename) {
-    std::ifstream stlin(filename, std::ios::binary);
-    if (!stlin.is_open()) {
-        std::cerr << "Error opening file for reading: " << filename << std::endl;
-        return Mesh3d(); // Or throw an exception
+// binary STL: 80 byte header, uint32_t number of triangles, per triangle 12 floats (normal, v0, v1, v2) and a uint16_t
+static Mesh3d decodeBinarySTL(const char* begin, const char* end, const std::string& filename) {
+    constexpr size_t CHUNK_TRIANGLES = 1 << 16;
+
+    if (end - begin < 84) {
+        throw std::runtime_error("Invalid binary STL " + filename + ": too small (" + std::to_string(end - begin) + " bytes)");
+    }
+    uint32_t numTriangles;
+    std::memcpy(&numTriangles, begin + 80, sizeof(numTriangles));
+    if (size_t(end - begin) != 84 + size_t(numTriangles) * 50) {
+        throw std::runtime_error("Invalid binary STL " + filename + ": " + std::to_string(end - begin) + " bytes for " 
+                                 + std::to_string(numTriangles) + " triangles");
     }
 
-    // 1. Read the entire file into a buffer
-    stlin.seekg(0, std::ios::end);
-    const size_t fileSize = stlin.tellg();
-    stlin.seekg(0, std::ios::beg);
+    Mesh3d ret(numTriangles);
+
+    forEachChunk((size_t(numTriangles) + CHUNK_TRIANGLES - 1) / CHUNK_TRIANGLES, [&](const size_t c) {
+        const uint32_t last = std::min<size_t>(numTriangles, (c + 1) * CHUNK_TRIANGLES);
+        for (uint32_t i = c * CHUNK_TRIANGLES; i < last; ++i) {
+            float record[12]; // normal, v0, v1, v2 (the attribute byte count is ignored)
+            std::memcpy(record, begin + 84 + size_t(i) * 50, sizeof(record));
+            ret.normx[i] = record[0]; ret.normy[i] = record[1];  ret.normz[i] = record[2];
+            ret.v0x[i] = record[3];   ret.v0y[i] = record[4];    ret.v0z[i] = record[5];
+            ret.v1x[i] = record[6];   ret.v1y[i] = record[7];    ret.v1z[i] = record[8];
+            ret.v2x[i] = record[9];   ret.v2y[i] = record[10];   ret.v2z[i] = record[11];
+        }
+    });
+
+    return ret;
+}
+
+Mesh3d importSTL(const std::string& filename) {
+    const MappedFile file(filename);
+    file.prefetch();
+    return decodeAsciiSTL(file.data(), file.data() + file.size(), filename);
+}
+
+Mesh3d importBinarySTL(const std::string& filename) {
+    const MappedFile file(filename);
+    file.prefetch();
+    return decodeBinarySTL(file.data(), file.data() + file.size(), filename);
+}
 
-    std::vector<char> buffer(fileSize);
-    stlin.read(buffer.data(), fileSize);
+Mesh3d loadSTL(const std::string& filename) {
+    const MappedFile file(filename);
+    file.prefetch();
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // binary files may start with "solid" as well, but their size always matches their triangle count
+    if (file.size() >= 84) {
+        uint32_t numTriangles;
+        std::memcpy(&numTriangles, begin + 80, sizeof(numTriangles));
+        if (file.size() == 84 + size_t(numTriangles) * 50) {
+            return decodeBinarySTL(begin, end, filename);
+        }
+    }
 
-    // 2. Validate the file size (at least 84 bytes, and 84 + 50*N)
-    if (fileSize < 84) {
-        std::cerr << "Error: Invalid STL file size (too small)." << std::endl;
-        return Mesh3d();
+    const char* p = begin;
+    while (p < end && isSpace(*p)) {
+        ++p;
     }
-    
-    // 3. Skip the header (80 bytes)
-    const char* dataPtr = buffer.data() + 80;
+    if (end - p >= 5 && std::memcmp(p, "solid", 5) == 0) {
+        return decodeAsciiSTL(begin, end, filename);
+    }
+    throw std::runtime_error("Not an STL file (or a truncated binary one): " + filename);
+}
 
-    // 4. Read the number of triangles (uint32_t)
-    uint32_t numTriangles;
-    std::memcpy(&numTriangles, dataPtr, sizeof(numTriangles));
+// any-hit test of the ray (sourcex, sourcey, sourcez) + t*ray, t > 0 against the mesh (BVH if built, else every triangle)
+bool Mesh3d::rayHit(const double& sourcex, const double& sourcey, const double& sourcez, const vertex& ray, trace_counts* counts) const {
+    const double EPSILON = 0.0000001;
+
+    const vertex rayOrigin = {sourcex, sourcey, sourcez}; // Create a vertex for the origin
+    const vertex invDir = {1.0 / ray.x, 1.0 / ray.y, 1.0 / ray.z};
+
+    // Slabs method for ray-AABB intersection (boxes entirely behind the origin are rejected as well)
+    auto boxHit = [&](const vertex& bbmin, const vertex& bbmax) {
+        double tmin = -INFINITY;
+        double tmax = INFINITY;
+
+        for (int i = 0; i < 3; ++i) {
+            double t0 = ((&bbmin.x)[i] - (&rayOrigin.x)[i]) * (&invDir.x)[i]; // Access x, y, z components using pointer arithmetic
+            double t1 = ((&bbmax.x)[i] - (&rayOrigin.x)[i]) * (&invDir.x)[i];
+
+            if ((&invDir.x)[i] < 0.0) {
+                std::swap(t0, t1);
+            }
 
-    dataPtr += sizeof(numTriangles);
+            tmin = std::max(tmin, t0);
+            tmax = std::min(tmax, t1);
 
-    // 5. Validate file size against the number of triangles
-    if (fileSize != 84 + (numTriangles * 50)) {
-        std::cerr << "Error: Invalid STL file size (mismatch with triangle count)." << std::endl;
-        return Mesh3d();
+            if (tmax * RAY_BOX_SLACK < tmin || tmax < 0.0) {
+                return false; // no intersection with AABB (widened for float geometry, see RAY_BOX_SLACK)
+            }
+        }
+        return true;
+    };
+
+    // Moller-Trumbore against a contiguous range of obstacle triangles
+    uint64_t triangle_tests = 0;
+    auto trianglesHit = [&](const uint32_t first, const uint32_t count) {
+        triangle_tests += count; // (an upper bound when a triangle hits)
+        for (uint32_t obs_idx = first; obs_idx < first + count; ++obs_idx) {
+
+            // Pre-calculated edges are obstacle members
+            const double edge1x = e1x[obs_idx];
+            const double edge1y = e1y[obs_idx];
+            const double edge1z = e1z[obs_idx];
+
+            const double edge2x = e2x[obs_idx];
+            const double edge2y = e2y[obs_idx];
+            const double edge2z = e2z[obs_idx];
+
+            const double hx = ray.y * edge2z - ray.z * edge2y;
+            const double hy = ray.z * edge2x - ray.x * edge2z;
+            const double hz = ray.x * edge2y - ray.y * edge2x;
+
+            const double a = edge1x * hx + edge1y * hy + edge1z * hz;
+
+            if (std::abs(a) < EPSILON)
+                continue;    // This ray is parallel to this triangle.
+
+            const double f = 1.0 / a;
+            const double sx = sourcex - v0x[obs_idx];
+            const double sy = sourcey - v0y[obs_idx];
+            const double sz = sourcez - v0z[obs_idx];
+
+            const double u = f * (sx * hx + sy * hy + sz * hz);
+            if (u < -RAY_EDGE_SLACK || u > 1.0 + RAY_EDGE_SLACK)
+                continue;
+
+            const double qx = sy * edge1z - sz * edge1y;
+            const double qy = sz * edge1x - sx * edge1z;
+            const double qz = sx * edge1y - sy * edge1x;
+
+            const double v = f * (ray.x * qx + ray.y * qy + ray.z * qz);
+            if (v < -RAY_EDGE_SLACK || u + v > 1.0 + RAY_EDGE_SLACK)
+                continue;
+
+            const double t = f * (edge2x * qx + edge2y * qy + edge2z * qz);
+            if (t > EPSILON) // ray intersection
+                return true;
+        }
+        return false;
+    };
+
+    // mesh without a hierarchy - check against its BoundingBox and then against every triangle
+    if (bvh.empty()) {
+        const bool hit = boxHit(bbmin, bbmax) && trianglesHit(0, triangle_count);
+        if (counts != nullptr) {
+            counts->rays += 1;
+            counts->triangle_tests += triangle_tests;
+        }
+        return hit;
     }
 
-    // 6. Resize member vectors
-    Mesh3d ret(numTriangles);
+    // any-hit traversal of the BVH (first hit ends the search, so the order of visiting children is irrelevant)
+    uint32_t stack[64];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    uint64_t nodes = 0, rejects = 0;
+    bool hit = false;
+
+    while (stack_size > 0 && !hit) {
+        const bvh_node& node = bvh[stack[--stack_size]];
+        ++nodes;
 
-    // 7. Read triangle data
-    for (uint32_t i = 0; i < numTriangles; ++i) {
-        float normal[3];
-        float v0[3];
-        float v1[3];
-        float v2[3];
-        uint16_t attributeByteCount;
-
-        std::memcpy(normal, dataPtr, sizeof(normal));
-        dataPtr += sizeof(normal);
-        std::memcpy(v0, dataPtr, sizeof(v0));
-        dataPtr += sizeof(v0);
-        std::memcpy(v1, dataPtr, sizeof(v1));
-        dataPtr += sizeof(v1);
-        std::memcpy(v2, dataPtr, sizeof(v2));
-        dataPtr += sizeof(v2);
-        std::memcpy(&attributeByteCount, dataPtr, sizeof(attributeByteCount));
-        dataPtr += sizeof(attributeByteCount);
-
-        // Assign to member variables
-        ret.normx[i] = normal[0];
-        ret.normy[i] = normal[1];
-        ret.normz[i] = normal[2];
-        ret.v0x[i] = v0[0];
-        ret.v0y[i] = v0[1];
-        ret.v0z[i] = v0[2];
-        ret.v1x[i] = v1[0];
-        ret.v1y[i] = v1[1];
-        ret.v1z[i] = v1[2];
-        ret.v2x[i] = v2[0];
-        ret.v2y[i] = v2[1];
-        ret.v2z[i] = v2[2];
-        // You might want to do something with attributeByteCount, but it's often ignored.
+        if (!boxHit(node.bbmin, node.bbmax)) {
+            ++rejects;
+            continue;
+        }
+
+        if (node.count > 0) {
+            hit = trianglesHit(node.first, node.count);
+        }
+        else {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first + 1;
+        }
     }
 
-    return ret;
+    if (counts != nullptr) {
+        *counts += trace_counts{1, triangle_tests, rejects, nodes};
+    }
+    return hit;
 }
-
@@ -4,6 +4,28 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <cmath>
+#include <limits>
+#include <type_traits>
+
+#include <Solar-Collector-Shape-Optimiser/stats.hpp>
+
+// precision of the per-triangle mesh data (and of the ray packets traced against it)
+// build with -DSINGLE_PRECISION_GEOMETRY to halve the memory traffic and double the SIMD width of the fitness loop
+#ifdef SINGLE_PRECISION_GEOMETRY
+    using real_t = float;
+#else
+    using real_t = double;
+#endif // SINGLE_PRECISION_GEOMETRY
+
+// float geometry is approximate: boxes are widened by pbrt's 1 + 2*gamma(3) (factor of the far distance of a ray through
+// a box) and triangles by a few ulps in barycentric space, so rounding can't open gaps between neighbouring obstacle
+// triangles and every obstacle test (packets, single rays, the ShadowTable) agrees on a ray (no-op for double)
+// near-edge rays can still go either way: widening blocks more incoming rays but also accepts more reflected ones, so
+// the fitness can differ from the double build by a few triangles in both directions
+constexpr real_t RAY_BOX_SLACK = std::is_same_v<real_t, float>
+                               ? 1 + 2 * (3 * std::numeric_limits<real_t>::epsilon() / (1 - 3 * std::numeric_limits<real_t>::epsilon())) : 1;
+constexpr real_t RAY_EDGE_SLACK = std::is_same_v<real_t, float> ? 16 * std::numeric_limits<real_t>::epsilon() : 0;
 
 struct vertex {
     double x;
@@ -23,27 +45,40 @@ struct triangle {
     triangle(vertex v1, vertex v2, vertex v3, vertex n, vertex m) : v{v1, v2, v3}, normal(n), midpoint(m) {};
 };
 
+// node of a flattened bounding volume hierarchy (children of an inner node are stored next to each other)
+struct bvh_node {
+    vertex bbmin;   // bounding box of all triangles under this node
+    vertex bbmax;
+    uint32_t first; // leaf: index of the first triangle; inner node: index of the left child (right child is first + 1)
+    uint32_t count; // leaf: number of triangles; inner node: 0
+
+    bvh_node() : bbmin(), bbmax(), first(0), count(0) {};
+};
+
 class Mesh3d {
 public:
     uint32_t triangle_count; // number of triangles in mesh
 
     // vertices defining triangles
-    std::vector<double> v0x, v0y, v0z; // x, y, z components of v0 vertex
-    std::vector<double> v1x, v1y, v1z; // x, y, z components of v1 vertex
-    std::vector<double> v2x, v2y, v2z; // x, y, z components of v2 vertex
+    std::vector<real_t> v0x, v0y, v0z; // x, y, z components of v0 vertex
+    std::vector<real_t> v1x, v1y, v1z; // x, y, z components of v1 vertex
+    std::vector<real_t> v2x, v2y, v2z; // x, y, z components of v2 vertex
     // vertices defining normals
-    std::vector<double> normx, normy, normz; // x, y, z components of a normal
+    std::vector<real_t> normx, normy, normz; // x, y, z components of a normal
     // vertices defining midpoints
-    std::vector<double> midpx, midpy, midpz; // x, y, z components of a midpoint
+    std::vector<real_t> midpx, midpy, midpz; // x, y, z components of a midpoint
 
     // OPTIONAL: edges for finding intersections in with obstacle
-    std::vector<double> e1x; std::vector<double> e1y; std::vector<double> e1z; // v1 - v0
-    std::vector<double> e2x; std::vector<double> e2y; std::vector<double> e2z; // v2 - v0
+    std::vector<real_t> e1x; std::vector<real_t> e1y; std::vector<real_t> e1z; // v1 - v0
+    std::vector<real_t> e2x; std::vector<real_t> e2y; std::vector<real_t> e2z; // v2 - v0
 
-    // TODO bounding box; make it recursive up to the depth of 4(?)
+    // bounding box of the whole mesh
     vertex bbmin;
     vertex bbmax;
 
+    // OPTIONAL: bounding volume hierarchy (root at index 0) for finding intersections with obstacle
+    std::vector<bvh_node> bvh;
+
     // constructors and a destructor
     Mesh3d();
     explicit Mesh3d(const uint32_t triangle_count);
@@ -60,6 +95,9 @@ public:
     void findNormals();
     void findEdges();
     void findBoundingBox();
+    void buildBVH(const uint32_t max_leaf_size = 4);
+    // any-hit test; the work done is added to `counts` (if given)
+    bool rayHit(const double& sourcex, const double& sourcey, const double& sourcez, const vertex& ray, trace_counts* counts = nullptr) const;
     void moveXY(const double& x, const double& y);
     void exportSTL(const std::string& filename) const;
     void exportBinarySTL(const std::string& filename) const;
@@ -76,8 +114,93 @@ vertex unitNormal(const triangle& t);
 vertex tMidPoint(const triangle& t);
 vertex calculateReflection(const vertex& normal, const vertex& ray);
 
-Mesh3d importSTL(const std::string& filename);
-Mesh3d importBinarySTL(const std::string& filename);
+// per-triangle kernels shared by Mesh3d and code that derives triangles without materialising a mesh
+
+// unit normal of triangle (v0, v1, v2) (zero for degenerate triangles)
+inline void triangleNormal(const real_t v0x, const real_t v0y, const real_t v0z, 
+                           const real_t v1x, const real_t v1y, const real_t v1z, 
+                           const real_t v2x, const real_t v2y, const real_t v2z, 
+                           real_t& normx, real_t& normy, real_t& normz) {
+    // Compute the vectors representing two sides of the triangle.
+    const double edge1x = v1x - v0x;
+    const double edge1y = v1y - v0y;
+    const double edge1z = v1z - v0z;
+
+    const double edge2x = v2x - v0x;
+    const double edge2y = v2y - v0y;
+    const double edge2z = v2z - v0z;
+
+    // Compute the cross product (normal vector).
+    const double nx = edge1y * edge2z - edge1z * edge2y;
+    const double ny = edge1z * edge2x - edge1x * edge2z;
+    const double nz = edge1x * edge2y - edge1y * edge2x;
+
+    // Normalize the normal vector.
+    const double magnitude = std::sqrt(nx * nx + ny * ny + nz * nz);
+
+    // Handle the case where the triangle is degenerate (magnitude is zero or very close to zero).
+    if (magnitude > 1e-12) // Use a small tolerance to avoid division by zero.
+    {
+        normx = nx / magnitude;
+        normy = ny / magnitude;
+        normz = nz / magnitude;
+    } else {
+        // For degenerate triangles, set the normal to a default value (e.g., zero).
+        normx = 0.0;
+        normy = 0.0;
+        normz = 0.0;
+    }
+}
+
+// circumcentre of triangle (v0, v1, v2)
+inline void triangleCircumcentre(const real_t v0x, const real_t v0y, const real_t v0z, 
+                                 const real_t v1x, const real_t v1y, const real_t v1z, 
+                                 const real_t v2x, const real_t v2y, const real_t v2z, 
+                                 real_t& midpx, real_t& midpy, real_t& midpz) {
+    // Fetch vertices.  Use 'const' to allow the compiler to optimize more.
+    const double ax = v0x;
+    const double ay = v0y;
+    const double az = v0z;
+    const double bx = v1x;
+    const double by = v1y;
+    const double bz = v1z;
+    const double cx = v2x;
+    const double cy = v2y;
+    const double cz = v2z;
+
+    // Calculate intermediate values.  Minimize redundant calculations.
+    const double bax = bx - ax;
+    const double bay = by - ay;
+    const double baz = bz - az;
+    const double cax = cx - ax;
+    const double cay = cy - ay;
+    const double caz = cz - az;
+
+    const double ba_mag2 = bax * bax + bay * bay + baz * baz;
+    const double ca_mag2 = cax * cax + cay * cay + caz * caz;
+
+    // Compute cross product of (B - A) and (C - A).
+    const double cross_x = bay * caz - baz * cay;
+    const double cross_y = baz * cax - bax * caz;
+    const double cross_z = bax * cay - bay * cax;
+
+    //  Compute the denominator of the circumcenter calculation.
+    const double denom = 0.5 / (cross_x * cross_x + cross_y * cross_y + cross_z * cross_z);
+
+    // Compute circumcenter coordinates.
+    const double ox = denom * (ba_mag2 * (cay * cross_z - caz * cross_y) + ca_mag2 * (baz * cross_y - bay * cross_z));
+    const double oy = denom * (ba_mag2 * (caz * cross_x - cax * cross_z) + ca_mag2 * (bax * cross_z - baz * cross_x));
+    const double oz = denom * (ba_mag2 * (cax * cross_y - cay * cross_x) + ca_mag2 * (bay * cross_x - bax * cross_y));
+    
+    midpx = ox + ax;
+    midpy = oy + ay;
+    midpz = oz + az;
+}
+
+// STL files are memory-mapped and decoded in parallel; invalid files throw
+Mesh3d importSTL(const std::string& filename);       // ASCII
+Mesh3d importBinarySTL(const std::string& filename); // binary
+Mesh3d loadSTL(const std::string& filename);         // either, detected from the file
 
 
 #endif // MESH3D
\ No newline at end of file
@@ -0,0 +1,29 @@
+#include <stdexcept>
+#include <string>
+
+#include <Solar-Collector-Shape-Optimiser/mesharena.hpp>
+
+MeshArena::MeshArena(const uint32_t slot_count, const uint32_t triangle_count)
+    : slot_count(slot_count)
+    , triangle_count(triangle_count)
+    , data(size_t(slot_count) * fields * triangle_count)
+{}
+
+MeshArena::~MeshArena() {}
+
+shape_view MeshArena::slot(const uint32_t idx) {
+    if (idx >= slot_count) {
+        throw std::runtime_error("MeshArena slot out of range: " + std::to_string(idx) + " >= " + std::to_string(slot_count));
+    }
+
+    real_t* base = data.data() + size_t(idx) * fields * triangle_count;
+
+    shape_view view;
+    view.normx = base + 0 * size_t(triangle_count);
+    view.normy = base + 1 * size_t(triangle_count);
+    view.normz = base + 2 * size_t(triangle_count);
+    view.midpx = base + 3 * size_t(triangle_count);
+    view.midpy = base + 4 * size_t(triangle_count);
+    view.midpz = base + 5 * size_t(triangle_count);
+    return view;
+}
@@ -0,0 +1,40 @@
+#ifndef MESHARENA_HPP
+#define MESHARENA_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <Solar-Collector-Shape-Optimiser/mesh3d.hpp>
+
+// per-triangle data of a shape that the fitness path reads (normals and circumcentres)
+// non-owning - it points into a MeshArena slot, or everywhere to nullptr if the shape keeps only its heightmap
+struct shape_view {
+    real_t* normx; real_t* normy; real_t* normz; // x, y, z components of a normal
+    real_t* midpx; real_t* midpy; real_t* midpz; // x, y, z components of a midpoint (circumcentre)
+
+    shape_view() : normx(nullptr), normy(nullptr), normz(nullptr), midpx(nullptr), midpy(nullptr), midpz(nullptr) {};
+
+    bool empty() const { return normx == nullptr; }
+};
+
+// one contiguous block holding the shape data of a whole population (slot after slot, each slot stored as SoA)
+class MeshArena {
+public:
+    uint32_t slot_count;     // number of shapes
+    uint32_t triangle_count; // number of triangles of every shape
+
+    MeshArena(const uint32_t slot_count, const uint32_t triangle_count);
+    // copying an arena would leave the views handed out pointing into the original
+    MeshArena(const MeshArena&) = delete;
+    MeshArena& operator=(const MeshArena&) = delete;
+    ~MeshArena();
+
+    shape_view slot(const uint32_t idx);
+
+private:
+    static constexpr uint32_t fields = 6; // normx, normy, normz, midpx, midpy, midpz
+
+    std::vector<real_t> data;
+};
+
+#endif // MESHARENA_HPP
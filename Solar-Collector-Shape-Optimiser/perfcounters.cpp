@@ -0,0 +1,82 @@
+#include <cstring>
+#include <cerrno>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <Solar-Collector-Shape-Optimiser/perfcounters.hpp>
+
+PerfCounters::PerfCounters(const uint64_t vector_event)
+    : error()
+    , fds{-1, -1, -1, -1, -1}
+    , slots()
+    , opened(0)
+{
+    const uint32_t types[PERF_EVENT_COUNT] = {PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_RAW};
+    const uint64_t configs[PERF_EVENT_COUNT] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+                                                PERF_COUNT_HW_BRANCH_MISSES, vector_event};
+
+    for (uint32_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+        if (event == PERF_VECTOR_INSTRUCTIONS && vector_event == 0)
+            continue;
+
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = types[event];
+        attr.config = configs[event];
+        attr.disabled = event == PERF_CYCLES; // the group starts counting when its leader is enabled
+        attr.exclude_kernel = 1;              // allowed with perf_event_paranoid <= 2
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        // this thread (pid 0), any cpu, cycles lead the group
+        const int fd = syscall(SYS_perf_event_open, &attr, 0, -1, event == PERF_CYCLES ? -1 : fds[PERF_CYCLES], 0);
+        if (fd < 0) {
+            if (event == PERF_CYCLES) {
+                error = std::string("perf_event_open failed (") + std::strerror(errno) + ")";
+                return;
+            }
+            continue; // not supported by this CPU - counted as 0
+        }
+        fds[event] = fd;
+        slots[event] = opened++;
+    }
+
+    if (ioctl(fds[PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+        error = std::string("Could not enable the perf counters (") + std::strerror(errno) + ")";
+        for (int& fd : fds) {
+            if (fd >= 0)
+                ::close(fd);
+            fd = -1;
+        }
+    }
+}
+
+PerfCounters::~PerfCounters() {
+    for (const int fd : fds) {
+        if (fd >= 0)
+            ::close(fd);
+    }
+}
+
+bool PerfCounters::read(perf_sample& sample) const {
+    if (!available())
+        return false;
+
+    // nr, time_enabled, time_running, values[nr]
+    uint64_t buffer[3 + PERF_EVENT_COUNT];
+    const ssize_t size = ::read(fds[PERF_CYCLES], buffer, sizeof(buffer));
+    if (size < ssize_t((3 + opened) * sizeof(uint64_t)) || buffer[0] != opened)
+        return false;
+
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    const double scale = running > 0 ? double(enabled) / running : 0.0;
+    for (uint32_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+        sample.values[event] = fds[event] >= 0 ? uint64_t(buffer[3 + slots[event]] * scale) : 0;
+    }
+    return true;
+}
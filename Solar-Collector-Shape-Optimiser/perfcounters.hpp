@@ -0,0 +1,49 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+
+// hardware events counted by PerfCounters
+enum perf_event_index : uint32_t {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_LLC_MISSES,          // last level cache misses
+    PERF_BRANCH_MISSES,
+    PERF_VECTOR_INSTRUCTIONS, // raw, model specific event (see PerfCounters)
+    PERF_EVENT_COUNT
+};
+
+constexpr const char* PERF_EVENT_NAMES[PERF_EVENT_COUNT] = {"Cycles", "Instructions", "LlcMisses", "BranchMisses", "VectorInstructions"};
+
+// counts of every event since the counters were opened
+struct perf_sample {
+    uint64_t values[PERF_EVENT_COUNT] = {};
+};
+
+// Linux perf_event_open counters of the calling thread (user space only), opened as one group so that a single read
+// returns all of them. Counting is optional: if the kernel denies access (see /proc/sys/kernel/perf_event_paranoid) or
+// there is no PMU (ex. in a VM), available() is false and `error` says why; events the CPU lacks are left out.
+// There is no generic event for vector instructions - `vector_event` is the raw code (umask << 8 | event) of one for the
+// CPU at hand, ex. 0x3cc7 (FP_ARITH_INST_RETIRED, packed 128 and 256 bit) on recent Intel cores; 0 leaves it out.
+class PerfCounters {
+public:
+    std::string error;
+
+    explicit PerfCounters(const uint64_t vector_event);
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+    ~PerfCounters();
+
+    bool available() const { return fds[PERF_CYCLES] >= 0; }
+    bool counts(const perf_event_index event) const { return fds[event] >= 0; }
+    // counts so far, scaled up for the time the group wasn't scheduled (multiplexing); false if the read failed
+    bool read(perf_sample& sample) const;
+
+private:
+    int fds[PERF_EVENT_COUNT];       // -1 for events that aren't counted
+    uint32_t slots[PERF_EVENT_COUNT]; // position of the event in the group's read
+    uint32_t opened;                 // number of events in the group
+};
+
+#endif // PERFCOUNTERS_HPP
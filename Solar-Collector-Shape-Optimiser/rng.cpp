@@ -0,0 +1,67 @@
+#include <random>
+
+#include <Solar-Collector-Shape-Optimiser/rng.hpp>
+
+// constants from the Random123 reference implementation
+static constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+static constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+static constexpr uint32_t PHILOX_W0 = 0x9E3779B9; // golden ratio
+static constexpr uint32_t PHILOX_W1 = 0xBB67AE85; // sqrt(3) - 1
+static constexpr uint32_t PHILOX_ROUNDS = 10;
+
+std::array<uint32_t, 4> Philox::operator()(const uint64_t hi, const uint64_t lo) const {
+    uint32_t c0 = uint32_t(lo), c1 = uint32_t(lo >> 32), c2 = uint32_t(hi), c3 = uint32_t(hi >> 32);
+    uint32_t k0 = uint32_t(key), k1 = uint32_t(key >> 32);
+
+    for (uint32_t round = 0; round < PHILOX_ROUNDS; ++round) {
+        const uint64_t p0 = uint64_t(PHILOX_M0) * c0;
+        const uint64_t p1 = uint64_t(PHILOX_M1) * c2;
+
+        c0 = uint32_t(p1 >> 32) ^ c1 ^ k0;
+        c1 = uint32_t(p1);
+        c2 = uint32_t(p0 >> 32) ^ c3 ^ k1;
+        c3 = uint32_t(p0);
+
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    return {c0, c1, c2, c3};
+}
+
+RngStream::RngStream(const uint64_t seed, const uint64_t stream)
+    : philox(seed)
+    , stream(stream)
+    , counter(0)
+{}
+
+// every block gives two doubles (53 random bits each)
+void RngStream::fill(double* out, const uint32_t count) {
+    constexpr double TO_UNIT = 1.0 / double(uint64_t(1) << 53);
+
+    const uint32_t blocks = count / 2;
+    for (uint32_t b = 0; b < blocks; ++b) {
+        const std::array<uint32_t, 4> r = philox(stream, counter + b);
+        out[2 * b]     = double(((uint64_t(r[1]) << 32) | r[0]) >> 11) * TO_UNIT;
+        out[2 * b + 1] = double(((uint64_t(r[3]) << 32) | r[2]) >> 11) * TO_UNIT;
+    }
+    counter += blocks;
+
+    if (count % 2) {
+        const std::array<uint32_t, 4> r = philox(stream, counter++);
+        out[count - 1] = double(((uint64_t(r[1]) << 32) | r[0]) >> 11) * TO_UNIT;
+    }
+}
+
+double RngStream::uniform() {
+    double ret;
+    fill(&ret, 1);
+    return ret;
+}
+
+RngStream& threadRng() {
+    thread_local RngStream rng = [] {
+        std::random_device rd;
+        return RngStream((uint64_t(rd()) << 32) | rd(), 0);
+    }();
+    return rng;
+}
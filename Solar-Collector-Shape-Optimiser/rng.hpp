@@ -0,0 +1,39 @@
+#ifndef RNG_HPP
+#define RNG_HPP
+
+#include <cstdint>
+#include <array>
+
+// counter-based generator Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// the output is a pure function of (key, counter), so any block of any stream can be generated independently -
+// no state is shared between threads and a whole run is reproducible from a single seed
+class Philox {
+public:
+    explicit Philox(const uint64_t key) : key(key) {};
+
+    // 128 random bits for the 128-bit counter (hi, lo)
+    std::array<uint32_t, 4> operator()(const uint64_t hi, const uint64_t lo) const;
+
+private:
+    uint64_t key;
+};
+
+// independent stream of uniform numbers, identified by (seed, stream) - ex. one per offspring and generation
+class RngStream {
+public:
+    RngStream(const uint64_t seed, const uint64_t stream);
+
+    // fills `out` with `count` uniform doubles from [0, 1) and advances the stream
+    void fill(double* out, const uint32_t count);
+    double uniform();
+
+private:
+    Philox philox;
+    uint64_t stream;  // high half of the counter
+    uint64_t counter; // low half of the counter - index of the next block
+};
+
+// stream of the calling thread for callers that don't bring their own (seeded once per thread from std::random_device)
+RngStream& threadRng();
+
+#endif // RNG_HPP
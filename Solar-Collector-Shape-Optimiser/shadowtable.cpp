@@ -0,0 +1,190 @@
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <iostream>
+
+#include <Solar-Collector-Shape-Optimiser/shadowtable.hpp>
+
+// same tolerances as the Moller-Trumbore test in Mesh3d::rayHit, so that both agree
+static constexpr double EPSILON = 0.0000001;
+// upper bound on the number of grid cells of one ray's table
+static constexpr uint64_t MAX_CELLS = uint64_t(1) << 26;
+// and on the number of triangles binned into them (a triangle counts once per cell it overlaps)
+static constexpr uint64_t MAX_ENTRIES = uint64_t(1) << 24;
+
+ShadowTable::ShadowTable(const Mesh3d& obstacle, const std::vector<vertex>& rays, const double resolution)
+    : rays(rays)
+    , tables()
+{
+    if (!(resolution > 0.0)) {
+        throw std::runtime_error("ShadowTable resolution needs to be greater than 0, got " + std::to_string(resolution));
+    }
+
+    tables.reserve(rays.size());
+    for (const vertex& ray : rays) {
+        tables.push_back(buildTable(obstacle, ray, resolution));
+    }
+}
+
+ShadowTable::~ShadowTable() {}
+
+ShadowTable::ray_table ShadowTable::buildTable(const Mesh3d& obstacle, const vertex& ray, const double resolution) {
+    ray_table table;
+
+    // points are tested towards the source of light, against the ray
+    const double dx = -ray.x, dy = -ray.y, dz = -ray.z;
+    if (std::abs(dy) < EPSILON) {
+        return table; // (almost) parallel to the ground - the projection degenerates
+    }
+
+    table.valid = true;
+    table.ux = dx / dy;
+    table.uz = dz / dy;
+    table.dy = dy;
+
+    // project the triangles, skipping the ones the ray is parallel to (Moller-Trumbore never reports those)
+    std::vector<shadow_entry> projected;
+    std::vector<double> boxes; // umin, umax, wmin, wmax of each projected triangle
+    projected.reserve(obstacle.triangle_count);
+    boxes.reserve(obstacle.triangle_count * 4);
+
+    double umin = INFINITY, umax = -INFINITY, wmin = INFINITY, wmax = -INFINITY;
+    for (uint32_t i = 0; i < obstacle.triangle_count; ++i) {
+        const double e1x = obstacle.e1x[i], e1y = obstacle.e1y[i], e1z = obstacle.e1z[i];
+        const double e2x = obstacle.e2x[i], e2y = obstacle.e2y[i], e2z = obstacle.e2z[i];
+
+        const double hx = dy * e2z - dz * e2y;
+        const double hy = dz * e2x - dx * e2z;
+        const double hz = dx * e2y - dy * e2x;
+        if (std::abs(e1x * hx + e1y * hy + e1z * hz) < EPSILON)
+            continue;
+
+        const double ay = obstacle.v0y[i];
+        const double au = obstacle.v0x[i] - ay * table.ux;
+        const double aw = obstacle.v0z[i] - ay * table.uz;
+        // projected edges (v1 - v0, v2 - v0)
+        const double pu1 = e1x - e1y * table.ux, pw1 = e1z - e1y * table.uz;
+        const double pu2 = e2x - e2y * table.ux, pw2 = e2z - e2y * table.uz;
+
+        const double det = pu1 * pw2 - pw1 * pu2;
+        if (det == 0.0)
+            continue;
+        const double inv_det = 1.0 / det;
+
+        shadow_entry entry;
+        entry.au = pw2 * inv_det;  entry.aw = -pu2 * inv_det; entry.ac = -(au * entry.au + aw * entry.aw);
+        entry.bu = -pw1 * inv_det; entry.bw = pu1 * inv_det;  entry.bc = -(au * entry.bu + aw * entry.bw);
+        entry.hu = entry.au * e1y + entry.bu * e2y;
+        entry.hw = entry.aw * e1y + entry.bw * e2y;
+        entry.hc = ay + entry.ac * e1y + entry.bc * e2y;
+        projected.push_back(entry);
+
+        // (binned with the margin of the widened triangle)
+        const double margin = RAY_EDGE_SLACK * (std::abs(pu1) + std::abs(pu2) + std::abs(pw1) + std::abs(pw2));
+        const double tumin = std::min({au, au + pu1, au + pu2}) - margin, tumax = std::max({au, au + pu1, au + pu2}) + margin;
+        const double twmin = std::min({aw, aw + pw1, aw + pw2}) - margin, twmax = std::max({aw, aw + pw1, aw + pw2}) + margin;
+        boxes.insert(boxes.end(), {tumin, tumax, twmin, twmax});
+
+        umin = std::min(umin, tumin); umax = std::max(umax, tumax);
+        wmin = std::min(wmin, twmin); wmax = std::max(wmax, twmax);
+    }
+
+    if (projected.empty()) {
+        table.ucount = table.wcount = 0;
+        table.offsets.assign(1, 0);
+        return table; // nothing casts a shadow
+    }
+
+    table.umin = umin;
+    table.wmin = wmin;
+    table.inv_cell = 1.0 / resolution;
+    // (in double - a ray close to the ground stretches the projection beyond any integer)
+    const double ucount = std::floor((umax - umin) * table.inv_cell) + 1.0;
+    const double wcount = std::floor((wmax - wmin) * table.inv_cell) + 1.0;
+    table.ucount = ucount * wcount <= double(MAX_CELLS) ? uint32_t(ucount) : 0;
+    table.wcount = ucount * wcount <= double(MAX_CELLS) ? uint32_t(wcount) : 0;
+
+    // grid cells overlapped by the bounding box of each projected triangle
+    auto cellRange = [&](const size_t k, uint32_t& cu0, uint32_t& cu1, uint32_t& cw0, uint32_t& cw1) {
+        cu0 = uint32_t((boxes[4 * k + 0] - umin) * table.inv_cell);
+        cu1 = std::min(uint32_t((boxes[4 * k + 1] - umin) * table.inv_cell), table.ucount - 1);
+        cw0 = uint32_t((boxes[4 * k + 2] - wmin) * table.inv_cell);
+        cw1 = std::min(uint32_t((boxes[4 * k + 3] - wmin) * table.inv_cell), table.wcount - 1);
+    };
+
+    // too big a table (ex. for a ray close to the ground, which stretches the projected triangles) isn't built - the
+    // ray's shadows are traced instead
+    uint64_t entry_count = 0;
+    for (size_t k = 0; table.ucount > 0 && k < projected.size(); ++k) {
+        uint32_t cu0, cu1, cw0, cw1;
+        cellRange(k, cu0, cu1, cw0, cw1);
+        entry_count += uint64_t(cu1 - cu0 + 1) * (cw1 - cw0 + 1);
+    }
+    if (table.ucount == 0 || entry_count > MAX_ENTRIES) {
+        std::cerr << "Warning: ShadowTable for ray " << ray.x << "," << ray.y << "," << ray.z << " would need "
+                  << ucount * wcount << " cells and " << (table.ucount == 0 ? "more" : std::to_string(entry_count)) 
+                  << " entries, its shadows are traced instead (a greater shadow_table_resolution may avoid that)" << std::endl;
+        return ray_table();
+    }
+
+    // CSR in two passes: count the entries of each cell, then fill them in
+    table.offsets.assign(size_t(table.ucount) * table.wcount + 1, 0);
+    for (size_t k = 0; k < projected.size(); ++k) {
+        uint32_t cu0, cu1, cw0, cw1;
+        cellRange(k, cu0, cu1, cw0, cw1);
+        for (uint32_t cw = cw0; cw <= cw1; ++cw)
+            for (uint32_t cu = cu0; cu <= cu1; ++cu)
+                ++table.offsets[size_t(cw) * table.ucount + cu + 1];
+    }
+    for (size_t c = 1; c < table.offsets.size(); ++c) {
+        table.offsets[c] += table.offsets[c - 1];
+    }
+
+    table.entries.resize(table.offsets.back());
+    std::vector<uint32_t> fill(table.offsets.begin(), table.offsets.end() - 1);
+    for (size_t k = 0; k < projected.size(); ++k) {
+        uint32_t cu0, cu1, cw0, cw1;
+        cellRange(k, cu0, cu1, cw0, cw1);
+        for (uint32_t cw = cw0; cw <= cw1; ++cw)
+            for (uint32_t cu = cu0; cu <= cu1; ++cu)
+                table.entries[fill[size_t(cw) * table.ucount + cu]++] = projected[k];
+    }
+
+    return table;
+}
+
+bool ShadowTable::covers(const uint32_t ray_idx) const {
+    return ray_idx < tables.size() && tables[ray_idx].valid;
+}
+
+bool ShadowTable::shadowed(const uint32_t ray_idx, const double x, const double y, const double z) const {
+    const ray_table& table = tables[ray_idx];
+
+    const double u = x - y * table.ux;
+    const double w = z - y * table.uz;
+
+    const double fu = (u - table.umin) * table.inv_cell;
+    const double fw = (w - table.wmin) * table.inv_cell;
+    if (!(fu >= 0.0 && fw >= 0.0 && fu < table.ucount && fw < table.wcount))
+        return false; // outside of every projected triangle
+
+    const size_t cell = size_t(fw) * table.ucount + size_t(fu);
+    for (uint32_t e = table.offsets[cell]; e < table.offsets[cell + 1]; ++e) {
+        const shadow_entry& entry = table.entries[e];
+
+        // barycentric coordinates, with the same bounds as Moller-Trumbore (widened for float geometry, see RAY_EDGE_SLACK)
+        const double a = entry.au * u + entry.aw * w + entry.ac;
+        if (a < -RAY_EDGE_SLACK || a > 1.0 + RAY_EDGE_SLACK)
+            continue;
+        const double b = entry.bu * u + entry.bw * w + entry.bc;
+        if (b < -RAY_EDGE_SLACK || a + b > 1.0 + RAY_EDGE_SLACK)
+            continue;
+
+        // distance along the ray to the crossing (in units of the ray's length)
+        const double t = (entry.hu * u + entry.hw * w + entry.hc - y) / table.dy;
+        if (t > EPSILON)
+            return true;
+    }
+    return false;
+}
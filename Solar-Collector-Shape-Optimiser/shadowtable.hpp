@@ -0,0 +1,52 @@
+#ifndef SHADOWTABLE_HPP
+#define SHADOWTABLE_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include <Solar-Collector-Shape-Optimiser/mesh3d.hpp>
+
+// precomputed answer to "is the point (x, y, z) in the obstacle's shadow for ray r?" (the first of the two obstacle tests
+// in computeFitness), built once from the obstacle and the rays - independent of the individuals
+//
+// every point is projected along the ray onto the ground plane (y = 0); points that project onto the same (u, w) lie on
+// one line parallel to the ray, and each obstacle triangle covering (u, w) crosses that line at a height that is an affine
+// function of (u, w) - the point is in shadow if it lies below (for rays going down) one of these crossings
+// the projected triangles are binned on a grid in (u, w) so that a lookup only tests the few triangles of one bin
+class ShadowTable {
+public:
+    std::vector<vertex> rays; // rays the table was built for
+
+    ShadowTable(const Mesh3d& obstacle, const std::vector<vertex>& rays, const double resolution = 1.0);
+    // copy, move constructors, assignments can be default
+    ~ShadowTable();
+
+    bool covers(const uint32_t ray_idx) const; // false for rays (almost) parallel to the ground or whose table would be too big - those have to be traced
+    bool shadowed(const uint32_t ray_idx, const double x, const double y, const double z) const;
+
+private:
+    // one obstacle triangle in projected space: barycentric coordinates and crossing height as affine functions of (u, w)
+    struct shadow_entry {
+        double au, aw, ac; // weight of v1
+        double bu, bw, bc; // weight of v2
+        double hu, hw, hc; // height at which the line through (u, w) crosses the triangle
+    };
+
+    struct ray_table {
+        bool valid;               // false if the ray is (almost) parallel to the ground
+        double ux, uz, dy;        // projection: u = x - y*ux, w = z - y*uz; dy is the y component of the ray
+        double umin, wmin;        // origin of the grid in (u, w)
+        double inv_cell;          // 1 / size of a grid cell
+        uint32_t ucount, wcount;  // number of grid cells along u and w
+        std::vector<uint32_t> offsets;      // CSR: entries of cell c are entries[offsets[c] .. offsets[c+1])
+        std::vector<shadow_entry> entries;
+
+        ray_table() : valid(false), ux(0), uz(0), dy(0), umin(0), wmin(0), inv_cell(0), ucount(0), wcount(0), offsets(), entries() {};
+    };
+
+    std::vector<ray_table> tables; // one per ray
+
+    static ray_table buildTable(const Mesh3d& obstacle, const vertex& ray, const double resolution);
+};
+
+#endif // SHADOWTABLE_HPP
@@ -1,4 +1,5 @@
 #include <cstdint>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -6,37 +7,84 @@
 #include <random>
 #include <execution>
 #include <ranges>
+#include <bit>
+#include <stdexcept>
 
 #include <Solar-Collector-Shape-Optimiser/solarcollector.hpp>
-
-SolarCollector::SolarCollector(const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs)
-    : SolarCollector(xs, ys, hm, obs, Genome((xs-1)*(ys-1)*2)) // same size as the mesh - ex. 3x3 shape has 4 rectangles -> 8 triangles
+#include <Solar-Collector-Shape-Optimiser/hash.hpp>
+
+SolarCollector::SolarCollector(const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const shape_view& storage, 
+                               const double gene_resolution, const double xsp, const double ysp, const double ctrl, 
+                               const uint32_t ctrl_xs, const uint32_t ctrl_ys)
+    : SolarCollector(xs, ys, hm, obs, 
+                     Genome(ctrl > 0.0 ? (ctrl_xs > 0 ? ctrl_xs : controlCount((xs-1)*xsp, ctrl)) // control points
+                                       * (ctrl_ys > 0 ? ctrl_ys : controlCount((ys-1)*ysp, ctrl))
+                                       : (xs-1)*(ys-1)*2, // same size as the mesh - ex. 3x3 shape has 4 rectangles -> 8 triangles
+                            0.0, hm, gene_resolution), 
+                     storage, xsp, ysp, ctrl, ctrl_xs, ctrl_ys) 
 {}
 
-SolarCollector::SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const Genome &genome)
+SolarCollector::SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const Genome &genome, const shape_view& storage,
+                                const double xsp, const double ysp, const double ctrl, const uint32_t ctrl_xs, const uint32_t ctrl_ys)
     : Genome(genome)
     , xsize(xs)
     , ysize(ys)
     , hmax(hm)
-    , shape_mesh((xs-1)*(ys-1)*2) // see comment above
+    , xspacing(xsp)
+    , yspacing(ysp)
+    , control_spacing(ctrl)
+    , control_xsize(ctrl <= 0.0 ? 0 : ctrl_xs > 0 ? ctrl_xs : controlCount((xs-1)*xsp, ctrl))
+    , control_ysize(ctrl <= 0.0 ? 0 : ctrl_ys > 0 ? ctrl_ys : controlCount((ys-1)*ysp, ctrl))
+    , surface(ctrl > 0.0 ? xs*ys : 0)
+    , surface_rows(size_t(control_ysize) * (ctrl > 0.0 ? xs : 0))
+    , triangle_count((xs-1)*(ys-1)*2) // see comment above
+    , shape(storage)
     , obstacle(obs) 
+    , fitness_chunks((triangle_count + FITNESS_CHUNK_SIZE - 1) / FITNESS_CHUNK_SIZE)
+    , reflecting()
+    , reflecting_stride((triangle_count + 63) / 64)
+    , inherited_from{nullptr, nullptr}
 {
+    if (control_spacing > 0.0 && dna_size != control_xsize * control_ysize) {
+        throw std::runtime_error("B-spline encoding needs " + std::to_string(control_xsize * control_ysize) + " genes, got: " 
+                                 + std::to_string(dna_size));
+    }
+    for (uint32_t chunk = 0; chunk < fitness_chunks.size(); ++chunk) {
+        fitness_chunks[chunk] = chunk * FITNESS_CHUNK_SIZE;
+    }
     computeMesh();
 }
 
 SolarCollector::~SolarCollector() {}
 
+void SolarCollector::breed(const SolarCollector &parent1, const SolarCollector &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range, 
+                           RngStream& rng) {
+    Genome::breed(parent1, parent2, crossover_bias, mutation_probability, mutation_range, rng);
+    computeMesh();
+    // parents survive until the offspring is evaluated, so it can reuse their results for triangles it inherited unchanged
+    inherited_from = {&parent1, &parent2};
+}
+
 double SolarCollector::getXY(const uint32_t x, const uint32_t y) const {
-    return dna[y * xsize + x];
+    return decodeGene(heightmap()[y * xsize + x]);
 }
 
 void SolarCollector::setXY(const uint32_t x, const uint32_t y, const double val) {
+    if (control_spacing > 0.0) {
+        throw std::runtime_error("Heights of a B-spline encoded collector can't be set, they follow its control points");
+    }
     if (val < 0)
-        dna[y * xsize + x] = 0;
+        setGene(y * xsize + x, 0);
     else if (val > hmax)
-        dna[y * xsize + x] = hmax;
+        setGene(y * xsize + x, hmax);
     else
-        dna[y * xsize + x] = val;
+        setGene(y * xsize + x, val);
+}
+
+// the tail of a heightmap's dna is still bred (and drifts), hashing it would tell identical shapes apart
+uint64_t SolarCollector::hashShape() const {
+    const uint32_t genes = shapeGenes();
+    return hashBytes(dna.data(), size_t(genes) * sizeof(gene_t), genes);
 }
 
 void SolarCollector::showYourself() const {
@@ -48,147 +96,503 @@ void SolarCollector::showYourself() const {
     }
 }
 
-bool SolarCollector::rayObstacleHit(const double& sourcex, const double& sourcey, const double& sourcez, 
-                                    const vertex& ray, bool invertRay) const {
-    const double EPSILON = 0.0000001;
-    const uint32_t obs_tri_count = obstacle->triangle_count;
-
-    const vertex usedRay = invertRay ? vertex{-ray.x, -ray.y, -ray.z} : ray;
-    const vertex rayOrigin = {sourcex, sourcey, sourcez}; // Create a vertex for the origin
-
-    // first check against BoundingBox
-    // Slabs method for ray-AABB intersection
-    double tmin = -INFINITY;
-    double tmax = INFINITY;
-
-    for (int i = 0; i < 3; ++i) {
-        double invDir = 1.0 / (&usedRay.x)[i]; // Access x, y, z components using pointer arithmetic
-        double t0 = ((&obstacle->bbmin.x)[i] - (&rayOrigin.x)[i]) * invDir;
-        double t1 = ((&obstacle->bbmax.x)[i] - (&rayOrigin.x)[i]) * invDir;
-
-        if (invDir < 0.0) {
-            std::swap(t0, t1);
+// the other grid's surface is sampled as it is meshed (see deriveGeometry): planar over each of a cell's two triangles, so
+// a finer grid reproduces the same shape
+void SolarCollector::resampleFrom(const SolarCollector& other) {
+    if (control_spacing > 0.0) {
+        // control points don't depend on the grid (same area, same spacing)
+        if (other.control_spacing != control_spacing || other.dna_size != dna_size) {
+            throw std::runtime_error("Cannot resample control points of a different B-spline");
         }
+        dna = other.dna;
+    }
+    else {
+        for (uint32_t y = 0; y < ysize; y++) {
+            // position of this height on the other grid: cell (ox, oy) and offsets (fx, fy) inside it
+            const double v = std::min(y * yspacing / other.yspacing, other.ysize - 1.0);
+            const uint32_t oy = std::min(uint32_t(v), other.ysize - 2);
+            const double fy = v - oy;
+            for (uint32_t x = 0; x < xsize; x++) {
+                const double u = std::min(x * xspacing / other.xspacing, other.xsize - 1.0);
+                const uint32_t ox = std::min(uint32_t(u), other.xsize - 2);
+                const double fx = u - ox;
+
+                const double h01 = other.getXY(ox, oy + 1);
+                const double h10 = other.getXY(ox + 1, oy);
+                if (fx + fy <= 1.0) {
+                    // (x, y), (x, y+1), (x+1, y)
+                    const double h00 = other.getXY(ox, oy);
+                    setXY(x, y, h00 + fx * (h10 - h00) + fy * (h01 - h00));
+                } else {
+                    // (x+1, y+1), (x+1, y), (x, y+1)
+                    const double h11 = other.getXY(ox + 1, oy + 1);
+                    setXY(x, y, h11 + (1.0 - fx) * (h01 - h11) + (1.0 - fy) * (h10 - h11));
+                }
+            }
+        }
+    }
+    fitness = 0.0;
+    evaluated_for = 0;
+    reflecting.clear();
+    inherited_from = {nullptr, nullptr};
+    computeMesh();
+}
 
-        tmin = std::max(tmin, t0);
-        tmax = std::min(tmax, t1);
+bool SolarCollector::rayObstacleHit(const double& sourcex, const double& sourcey, const double& sourcez, 
+                                    const vertex& ray, bool invertRay, trace_counts* counts) const {
+    const vertex usedRay = invertRay ? vertex{-ray.x, -ray.y, -ray.z} : ray;
+    return obstacle->rayHit(sourcex, sourcey, sourcez, usedRay, counts);
+}
 
-        if (tmax <= tmin) {
-            return false; // no intersection with AABB
+uint32_t SolarCollector::rayPacketObstacleHit(const ray_packet& packet, const uint32_t active, trace_counts& counts) const {
+    const real_t EPSILON = 0.0000001;
+    // (float geometry is widened, see RAY_BOX_SLACK and RAY_EDGE_SLACK)
+    constexpr real_t BOX_SLACK = RAY_BOX_SLACK;
+    constexpr real_t EDGE_SLACK = RAY_EDGE_SLACK;
+
+    if (uint32_t(std::popcount(active)) < RAY_PACKET_MIN_ACTIVE || obstacle->bvh.empty()) {
+        // too few rays to pay off (or no hierarchy to share) - trace lane by lane
+        uint32_t hit = 0;
+        for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+            if ((active >> l) & 1u) {
+                const vertex dir(packet.dx[l], packet.dy[l], packet.dz[l]);
+                hit |= uint32_t(rayObstacleHit(packet.ox[l], packet.oy[l], packet.oz[l], dir, false, &counts)) << l;
+            }
         }
+        return hit;
     }
 
-    for (uint32_t obs_idx = 0; obs_idx < obs_tri_count; ++obs_idx) {
-        
-        // Use a simplified ray-triangle intersection check (Moller-Trumbore)
-
-        // Pre-calculated edges are now class members (obs_edge1, obs_edge2)
-        const double edge1x = obstacle->e1x[obs_idx];
-        const double edge1y = obstacle->e1y[obs_idx];
-        const double edge1z = obstacle->e1z[obs_idx];
+    alignas(64) real_t invx[RAY_PACKET_SIZE], invy[RAY_PACKET_SIZE], invz[RAY_PACKET_SIZE];
+    // per-lane state is kept as 0/1 integers so that lane loops stay branchless;
+    // a lane is live while it is active and hasn't hit anything yet
+    alignas(64) int64_t live[RAY_PACKET_SIZE];
+    for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+        invx[l] = real_t(1) / packet.dx[l];
+        invy[l] = real_t(1) / packet.dy[l];
+        invz[l] = real_t(1) / packet.dz[l];
+        live[l] = (active >> l) & 1u;
+    }
 
-        const double edge2x = obstacle->e2x[obs_idx];
-        const double edge2y = obstacle->e2y[obs_idx];
-        const double edge2z = obstacle->e2z[obs_idx];
+    // Slabs method for all lanes at once; true if any live ray enters the box in front of its origin
+    // (node bounds come from real_t vertices, so converting them back to real_t is exact)
+    auto boxHit = [&](const bvh_node& node) {
+        const real_t minx = node.bbmin.x, miny = node.bbmin.y, minz = node.bbmin.z;
+        const real_t maxx = node.bbmax.x, maxy = node.bbmax.y, maxz = node.bbmax.z;
+        int64_t any = 0;
+        for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+            const real_t tx0 = (minx - packet.ox[l]) * invx[l];
+            const real_t tx1 = (maxx - packet.ox[l]) * invx[l];
+            const real_t ty0 = (miny - packet.oy[l]) * invy[l];
+            const real_t ty1 = (maxy - packet.oy[l]) * invy[l];
+            const real_t tz0 = (minz - packet.oz[l]) * invz[l];
+            const real_t tz1 = (maxz - packet.oz[l]) * invz[l];
+
+            real_t tmin = -INFINITY;
+            real_t tmax = INFINITY;
+            tmin = std::max(tmin, invx[l] < 0.0 ? tx1 : tx0);
+            tmax = std::min(tmax, invx[l] < 0.0 ? tx0 : tx1);
+            tmin = std::max(tmin, invy[l] < 0.0 ? ty1 : ty0);
+            tmax = std::min(tmax, invy[l] < 0.0 ? ty0 : ty1);
+            tmin = std::max(tmin, invz[l] < 0.0 ? tz1 : tz0);
+            tmax = std::min(tmax, invz[l] < 0.0 ? tz0 : tz1);
+
+            tmax *= BOX_SLACK;
+
+            any |= live[l] & int64_t(tmax >= tmin) & int64_t(tmax >= 0);
+        }
+        return any != 0;
+    };
 
-        const double hx = usedRay.y * edge2z - usedRay.z * edge2y;
-        const double hy = usedRay.z * edge2x - usedRay.x * edge2z;
-        const double hz = usedRay.x * edge2y - usedRay.y * edge2x;
+    // the first active ray decides in which order children are visited
+    const uint32_t lead = std::countr_zero(active);
 
-        const double a = edge1x * hx + edge1y * hy + edge1z * hz;
+    uint32_t stack[64];
+    uint32_t stack_size = 0;
+    stack[stack_size++] = 0;
+    counts.rays += std::popcount(active);
 
-        if (std::abs(a) < EPSILON)
-            continue;    // This ray is parallel to this triangle.
+    while (stack_size > 0) {
+        const bvh_node& node = obstacle->bvh[stack[--stack_size]];
+        ++counts.bvh_nodes;
 
-        const double f = 1.0 / a;
-        const double sx = sourcex - obstacle->v0x[obs_idx];
-        const double sy = sourcey - obstacle->v0y[obs_idx];
-        const double sz = sourcez - obstacle->v0z[obs_idx];
+        if (!boxHit(node)) {
+            ++counts.aabb_rejects;
+            continue;
+        }
 
-        const double u = f * (sx * hx + sy * hy + sz * hz);
-        if (u < 0.0 || u > 1.0)
+        if (node.count == 0) {
+            // visit the nearer child first, so that blocked lanes retire sooner
+            const bvh_node& left = obstacle->bvh[node.first];
+            const bvh_node& right = obstacle->bvh[node.first + 1];
+            const real_t sep = (right.bbmin.x + right.bbmax.x - left.bbmin.x - left.bbmax.x) * packet.dx[lead]
+                             + (right.bbmin.y + right.bbmax.y - left.bbmin.y - left.bbmax.y) * packet.dy[lead]
+                             + (right.bbmin.z + right.bbmax.z - left.bbmin.z - left.bbmax.z) * packet.dz[lead];
+            stack[stack_size++] = sep >= 0 ? node.first + 1 : node.first;
+            stack[stack_size++] = sep >= 0 ? node.first : node.first + 1;
             continue;
+        }
 
-        const double qx = sy * edge1z - sz * edge1y;
-        const double qy = sz * edge1x - sx * edge1z;
-        const double qz = sx * edge1y - sy * edge1x;
+        // Moller-Trumbore, one obstacle triangle against every lane of the packet
+        for (uint32_t obs_idx = node.first; obs_idx < node.first + node.count; ++obs_idx) {
+            ++counts.triangle_tests;
+            const real_t edge1x = obstacle->e1x[obs_idx];
+            const real_t edge1y = obstacle->e1y[obs_idx];
+            const real_t edge1z = obstacle->e1z[obs_idx];
+
+            const real_t edge2x = obstacle->e2x[obs_idx];
+            const real_t edge2y = obstacle->e2y[obs_idx];
+            const real_t edge2z = obstacle->e2z[obs_idx];
+
+            const real_t v0x = obstacle->v0x[obs_idx];
+            const real_t v0y = obstacle->v0y[obs_idx];
+            const real_t v0z = obstacle->v0z[obs_idx];
+
+            int64_t any_live = 0;
+            for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+                const real_t hx = packet.dy[l] * edge2z - packet.dz[l] * edge2y;
+                const real_t hy = packet.dz[l] * edge2x - packet.dx[l] * edge2z;
+                const real_t hz = packet.dx[l] * edge2y - packet.dy[l] * edge2x;
+
+                const real_t a = edge1x * hx + edge1y * hy + edge1z * hz;
+                const real_t f = real_t(1) / a;
+
+                const real_t sx = packet.ox[l] - v0x;
+                const real_t sy = packet.oy[l] - v0y;
+                const real_t sz = packet.oz[l] - v0z;
+
+                const real_t u = f * (sx * hx + sy * hy + sz * hz);
+
+                const real_t qx = sy * edge1z - sz * edge1y;
+                const real_t qy = sz * edge1x - sx * edge1z;
+                const real_t qz = sx * edge1y - sy * edge1x;
+
+                const real_t v = f * (packet.dx[l] * qx + packet.dy[l] * qy + packet.dz[l] * qz);
+                const real_t t = f * (edge2x * qx + edge2y * qy + edge2z * qz);
+
+                // same conditions as the scalar version, evaluated without branches
+                const int64_t lane_hit = int64_t(!(std::abs(a) < EPSILON))
+                                       & int64_t(u >= -EDGE_SLACK) & int64_t(u <= 1 + EDGE_SLACK)
+                                       & int64_t(v >= -EDGE_SLACK) & int64_t(u + v <= 1 + EDGE_SLACK)
+                                       & int64_t(t > EPSILON);
+                live[l] &= ~lane_hit;
+                any_live |= live[l];
+            }
 
-        const double v = f * (usedRay.x * qx + usedRay.y * qy + usedRay.z * qz);
-        if (v < 0.0 || u + v > 1.0)
-            continue;
+            if (any_live == 0)
+                return active; // every lane is already blocked
+        }
+    }
 
-        const double t = f * (edge2x * qx + edge2y * qy + edge2z * qz);
-        if (t > EPSILON) // ray intersection
-            return true;
+    uint32_t hit = active;
+    for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+        hit &= ~(uint32_t(live[l]) << l);
     }
-    return false;
+    return hit;
 }
 
-void SolarCollector::computeFitness(const std::vector<vertex>& rays) {
-    // fitness is based on the amount of `mesh` triangles that reflect the `ray` directly onto an `obstacle`
-    // add bounding boxes to obstacle as it doesn't change (AABB, BVH, Slab method); even a BB that covers the whole obstacle would speed the process up significantly
+// normals and circumcentres of mesh triangles [first, first+count) straight from the heightmap, walking its rows
+// every grid cell (x, y) is split into two triangles sharing the cell's four heights; x and z are the implicit grid
+// coordinates (note the swapped coordinates - height is stored in the y component)
+// `first` and `count` must be even (whole cells) - chunks and packets always are
+void SolarCollector::deriveGeometry(const uint32_t first, const uint32_t count, real_t* normx, real_t* normy, real_t* normz, 
+                                    real_t* midpx, real_t* midpy, real_t* midpz) const {
+    uint32_t x = (first / 2) % (xsize - 1);
+    uint32_t y = (first / 2) / (xsize - 1);
+
+    for (uint32_t i = 0; i < count; i += 2) {
+        const gene_t* row0 = heightmap() + y * xsize;
+        const gene_t* row1 = row0 + xsize;
+
+        const real_t x0 = x * xspacing, x1 = (x + 1) * xspacing;
+        const real_t z0 = y * yspacing, z1 = (y + 1) * yspacing;
+        const real_t h00 = decodeGene(row0[x]), h10 = decodeGene(row0[x + 1]);
+        const real_t h01 = decodeGene(row1[x]), h11 = decodeGene(row1[x + 1]);
+
+        // (x, y), (x, y+1), (x+1, y)
+        triangleNormal(x0, h00, z0, x0, h01, z1, x1, h10, z0, normx[i], normy[i], normz[i]);
+        triangleCircumcentre(x0, h00, z0, x0, h01, z1, x1, h10, z0, midpx[i], midpy[i], midpz[i]);
+        // (x+1, y+1), (x+1, y), (x, y+1)
+        triangleNormal(x1, h11, z1, x1, h10, z0, x0, h01, z1, normx[i + 1], normy[i + 1], normz[i + 1]);
+        triangleCircumcentre(x1, h11, z1, x1, h10, z0, x0, h01, z1, midpx[i + 1], midpy[i + 1], midpz[i + 1]);
+
+        if (++x == xsize - 1) {
+            x = 0;
+            ++y;
+        }
+    }
+}
 
-    const uint32_t mesh_tri_count = shape_mesh.triangle_count;
+// true if mesh triangle `i` has the same vertices in both individuals (see deriveGeometry for the triangle layout)
+bool SolarCollector::sameTriangle(const SolarCollector& other, const uint32_t i) const {
+    const uint32_t cell = i / 2;
+    const uint32_t x = cell % (xsize - 1);
+    const uint32_t y = cell / (xsize - 1);
+
+    // both triangles of a cell share (x, y + 1) and (x + 1, y); the first one adds (x, y), the second one (x + 1, y + 1)
+    const uint32_t corner = (i % 2) ? (y + 1) * xsize + x + 1 : y * xsize + x;
+    const gene_t* heights = heightmap();
+    const gene_t* other_heights = other.heightmap();
+    return heights[corner] == other_heights[corner]
+        && heights[(y + 1) * xsize + x] == other_heights[(y + 1) * xsize + x]
+        && heights[y * xsize + x + 1] == other_heights[y * xsize + x + 1];
+}
 
-    fitness = 0.0; // Reset fitness
+// traces mesh triangles [first, last) for all `rays`, stores the results in `reflecting` and returns how many reflect
+// triangles identical to the ones of a `sources` individual (may be nullptr) are copied from its bitset instead of traced
+// consecutive mesh triangles are traced together as packets of RAY_PACKET_SIZE rays
+uint32_t SolarCollector::traceRange(const std::vector<vertex>& rays, const uint32_t first, const uint32_t last, 
+                                    const std::array<const SolarCollector*, 2>& sources, const ShadowTable* shadows, 
+                                    const AcceptanceMap* acceptance) {
+    uint32_t reflecting_count = 0;
+    trace_counts counts; // added to Stats once per range, not per ray
+
+    // --- Step 1: Iterate through packets of *mesh* triangles ---
+    for (uint32_t base = first; base < last; base += RAY_PACKET_SIZE) {
+        const uint32_t lanes = std::min(RAY_PACKET_SIZE, last - base);
+        const uint32_t active = (1u << lanes) - 1;
+
+        // lanes whose results can be copied from one of the sources (the same for every ray)
+        uint32_t inherited[2] = {0, 0};
+        for (uint32_t k = 0; k < 2; ++k) {
+            if (sources[k] == nullptr)
+                continue;
+            for (uint32_t l = 0; l < lanes; ++l) {
+                inherited[k] |= uint32_t(sameTriangle(*sources[k], base + l)) << l;
+            }
+        }
+        inherited[1] &= ~inherited[0];
+        const uint32_t traced = active & ~(inherited[0] | inherited[1]);
+
+        // normals and circumcentres of the packet's triangles (from the shape's slot, or derived from the heightmap)
+        alignas(64) real_t nx[RAY_PACKET_SIZE] = {}, ny[RAY_PACKET_SIZE] = {}, nz[RAY_PACKET_SIZE] = {};
+        alignas(64) real_t mx[RAY_PACKET_SIZE] = {}, my[RAY_PACKET_SIZE] = {}, mz[RAY_PACKET_SIZE] = {};
+        if (traced != 0) {
+            if (shape.empty()) {
+                deriveGeometry(base, lanes, nx, ny, nz, mx, my, mz);
+            }
+            else {
+                for (uint32_t l = 0; l < lanes; ++l) {
+                    nx[l] = shape.normx[base + l]; ny[l] = shape.normy[base + l]; nz[l] = shape.normz[base + l];
+                    mx[l] = shape.midpx[base + l]; my[l] = shape.midpy[base + l]; mz[l] = shape.midpz[base + l];
+                }
+            }
+        }
 
+        // --- Step 2 & 3: Iterate through rays ---
+        for (uint32_t ray_idx = 0; ray_idx < rays.size(); ++ray_idx) {
+            const real_t rx = rays[ray_idx].x, ry = rays[ray_idx].y, rz = rays[ray_idx].z;
 
-    // --- Step 1: Iterate through rays ---
-    for (const auto& ray : rays) {
+            // packets never straddle a word of the bitset (chunks and packets are aligned to their sizes)
+            const uint32_t word = ray_idx * reflecting_stride + base / 64;
+            const uint32_t shift = base % 64;
 
-        // --- Step 2 & 3: Iterate through *mesh* triangles ---
-        for (uint32_t mesh_idx = 0; mesh_idx < mesh_tri_count; ++mesh_idx) {
-            // 2.1 Calculate reflected ray for the *current mesh triangle*.
-            const vertex mesh_normal(shape_mesh.normx[mesh_idx], shape_mesh.normy[mesh_idx], shape_mesh.normz[mesh_idx]); // Get precomputed normal
+            uint32_t reflecting_lanes = 0;
+            for (uint32_t k = 0; k < 2; ++k) {
+                if (inherited[k] != 0) {
+                    reflecting_lanes |= uint32_t(sources[k]->reflecting[word] >> shift) & inherited[k];
+                }
+            }
 
-            const vertex reflection = calculateReflection(mesh_normal, ray); // Simpler reflection calculation
+            if (traced != 0) {
+                ray_packet incoming;  // from the midpoints towards the source of light
+                ray_packet reflected; // from the midpoints along the reflected rays
+
+                // 2.1 Calculate reflected ray for every *mesh triangle* of the packet (same as calculateReflection).
+                // (unused lanes hold zeros and stay inactive)
+                for (uint32_t l = 0; l < RAY_PACKET_SIZE; ++l) {
+                    const real_t dot = rx * nx[l] + ry * ny[l] + rz * nz[l];
+
+                    incoming.ox[l] = reflected.ox[l] = mx[l];
+                    incoming.oy[l] = reflected.oy[l] = my[l];
+                    incoming.oz[l] = reflected.oz[l] = mz[l];
+
+                    incoming.dx[l] = -rx;
+                    incoming.dy[l] = -ry;
+                    incoming.dz[l] = -rz;
+
+                    reflected.dx[l] = rx - 2 * dot * nx[l];
+                    reflected.dy[l] = ry - 2 * dot * ny[l];
+                    reflected.dz[l] = rz - 2 * dot * nz[l];
+                }
+
+                // --- Step 4: Check packets against the obstacle ---
+                // rays blocked by the obstacle don't reach the mesh triangle
+                uint32_t blocked = 0;
+                if (shadows != nullptr && shadows->covers(ray_idx)) {
+                    for (uint32_t l = 0; l < lanes; ++l) {
+                        if ((traced >> l) & 1)
+                            blocked |= uint32_t(shadows->shadowed(ray_idx, mx[l], my[l], mz[l])) << l;
+                    }
+                }
+                else {
+                    blocked = rayPacketObstacleHit(incoming, traced, counts);
+                }
+
+                // if reflected ray hits the obstacle increment fitness
+                if (acceptance != nullptr) {
+                    for (uint32_t l = 0; l < lanes; ++l) {
+                        if (((traced & ~blocked) >> l) & 1)
+                            reflecting_lanes |= uint32_t(acceptance->accepts(mx[l], my[l], mz[l], reflected.dx[l], reflected.dy[l], reflected.dz[l])) << l;
+                    }
+                }
+                else {
+                    reflecting_lanes |= rayPacketObstacleHit(reflected, traced & ~blocked, counts);
+                }
+            }
 
+            reflecting[word] = (reflecting[word] & ~(uint64_t(active) << shift)) | (uint64_t(reflecting_lanes) << shift);
+            reflecting_count += std::popcount(reflecting_lanes);
+        }
+    }
+    Stats::add(counts);
+    return reflecting_count;
+}
 
-            // --- Step 4: Check against *all obstacle triangles* ---
-            const double midx = shape_mesh.midpx[mesh_idx];            
-            const double midy = shape_mesh.midpy[mesh_idx];
-            const double midz = shape_mesh.midpz[mesh_idx];
+void SolarCollector::computeFitness(const std::vector<vertex>& rays, const ShadowTable* shadows, const AcceptanceMap* acceptance) {
+    // fitness is based on the amount of `mesh` triangles that reflect the `ray` directly onto an `obstacle`
+    // intersections are found by traversing the obstacle's BVH (see Mesh3d::buildBVH)
+    // the mesh is split into chunks of FITNESS_CHUNK_SIZE triangles traced as separate tasks, so that a single individual
+    // can saturate the machine; nested inside the parallel loop over the population, the scheduler balances both levels
+    // an offspring only traces the triangles it doesn't share with one of the individuals it was `inherited_from`
+    // with a ShadowTable only the reflected ray is traced, the incoming one is a lookup (with an AcceptanceMap so is the reflected one)
+
+    const uint32_t mesh_tri_count = triangle_count;
+
+    if (shadows != nullptr) {
+        bool same_rays = shadows->rays.size() == rays.size();
+        for (size_t r = 0; same_rays && r < rays.size(); ++r) {
+            same_rays = shadows->rays[r].x == rays[r].x && shadows->rays[r].y == rays[r].y && shadows->rays[r].z == rays[r].z;
+        }
+        if (!same_rays)
+            throw std::runtime_error("ShadowTable was built for different rays than the ones passed to computeFitness");
+    }
 
-            // if ray hits (is blocked by) the obstacle continue to the next mesh triangle
-            if (rayObstacleHit(midx, midy, midz, ray, true)) {
-                continue;
-            }
+    reflecting.resize(rays.size() * reflecting_stride);
 
-            // Check against all obstacle triangles (for reflected rays)
-            // if reflected ray hits the obstacle increment fitness
-            if (rayObstacleHit(midx, midy, midz, reflection, false)) {
-                fitness += 1.0;
-            }
+    // a parent can only be used if it was evaluated with the same rays
+    std::array<const SolarCollector*, 2> sources{nullptr, nullptr};
+    for (uint32_t k = 0; k < 2; ++k) {
+        const SolarCollector* parent = inherited_from[k];
+        if (parent != nullptr && parent != this && parent->xsize == xsize && parent->ysize == ysize 
+                              && parent->xspacing == xspacing && parent->yspacing == yspacing
+                              && parent->reflecting.size() == reflecting.size()) {
+            sources[k] = parent;
+        }
+    }
+    inherited_from = {nullptr, nullptr};
+
+    auto traceChunk = [&](const uint32_t first) -> uint64_t {
+        const uint32_t last = std::min(first + FITNESS_CHUNK_SIZE, mesh_tri_count);
+        return traceRange(rays, first, last, sources, shadows, acceptance);
+    };
+
+    #ifndef NO_STD_EXECUTION
+        const uint64_t reflecting_count = std::transform_reduce(std::execution::par, 
+                                                                fitness_chunks.begin(), fitness_chunks.end(), 
+                                                                uint64_t(0), std::plus<>(), traceChunk);
+    #else 
+        uint64_t reflecting_count = 0;
+        #pragma omp taskloop grainsize(1) reduction(+:reflecting_count)
+        for (size_t chunk = 0; chunk < fitness_chunks.size(); ++chunk) {
+            reflecting_count += traceChunk(fitness_chunks[chunk]);
+        }
+    #endif // NO_STD_EXECUTION
+
+    // triangles of coarse grids count for the area they cover (the fitness of a stage is comparable to the next one)
+    fitness = reflecting_count * xspacing * yspacing;
+}
+
+// takes a fitness computed before (ex. by an identical individual, see FitnessCache) instead of tracing
+// there are no per-triangle results then, so offspring of this individual trace the triangles they inherit from it
+void SolarCollector::adoptFitness(const double known_fitness, const uint64_t key) {
+    fitness = known_fitness;
+    evaluated_for = key;
+    reflecting.clear();
+    inherited_from = {nullptr, nullptr};
+}
+
+// heightmap of the B-spline encoding: every height is a blend of the 4x4 control points around it, with weights of the
+// uniform cubic B-spline basis (control point i along a side sits at (i - 1) * control_spacing, so the basis functions
+// cover the whole collector); separable - the control rows are blended along x first, then the results along y
+void SolarCollector::expandSurface() {
+    // segment and basis weights of a position `t` (in control spacings)
+    auto basis = [](const double t, const uint32_t control_count, uint32_t& segment, double* w) {
+        segment = std::min(uint32_t(t), control_count - 4); // (t can be the far end of the last segment)
+        const double u = t - segment;
+        w[0] = (1.0 - u) * (1.0 - u) * (1.0 - u) / 6.0;
+        w[1] = (3.0 * u * u * u - 6.0 * u * u + 4.0) / 6.0;
+        w[2] = (-3.0 * u * u * u + 3.0 * u * u + 3.0 * u + 1.0) / 6.0;
+        w[3] = u * u * u / 6.0;
+    };
+
+    // control rows blended along x: control_ysize x xsize
+    std::vector<double>& rows = surface_rows;
+    for (uint32_t x = 0; x < xsize; ++x) {
+        uint32_t segment;
+        double w[4];
+        basis(x * xspacing / control_spacing, control_xsize, segment, w);
+        for (uint32_t cy = 0; cy < control_ysize; ++cy) {
+            const gene_t* controls = dna.data() + size_t(cy) * control_xsize + segment;
+            rows[size_t(cy) * xsize + x] = w[0] * decodeGene(controls[0]) + w[1] * decodeGene(controls[1]) 
+                                         + w[2] * decodeGene(controls[2]) + w[3] * decodeGene(controls[3]);
+        }
+    }
 
+    for (uint32_t y = 0; y < ysize; ++y) {
+        uint32_t segment;
+        double w[4];
+        basis(y * yspacing / control_spacing, control_ysize, segment, w);
+        const double* r0 = rows.data() + size_t(segment) * xsize;
+        for (uint32_t x = 0; x < xsize; ++x) {
+            const double h = w[0] * r0[x] + w[1] * r0[x + xsize] + w[2] * r0[x + 2 * xsize] + w[3] * r0[x + 3 * xsize];
+            surface[size_t(y) * xsize + x] = encodeGene(h);
         }
     }
 }
 
 void SolarCollector::computeMesh() {
+    if (control_spacing > 0.0) {
+        expandSurface();
+    }
+    if (shape.empty()) {
+        return; // only the heightmap is stored - computeFitness derives the triangles on the fly
+    }
+
+    deriveGeometry(0, triangle_count, shape.normx, shape.normy, shape.normz, shape.midpx, shape.midpy, shape.midpz);
+}
+
+// full mesh (vertices, normals and circumcentres) of the shape, e.g. for exporting it
+Mesh3d SolarCollector::buildMesh() const {
+    Mesh3d mesh(triangle_count);
+
     uint32_t i = 0;
     for (uint32_t y = 0; y < ysize - 1; y++) {
         for (uint32_t x = 0; x < xsize - 1; x++) {
-            shape_mesh.v0x[i] = x;     shape_mesh.v0z[i] = y;     shape_mesh.v0y[i] = getXY(x, y);   // swapped coordinates
-            shape_mesh.v1x[i] = x;     shape_mesh.v1z[i] = y + 1; shape_mesh.v1y[i] = getXY(x, y + 1);
-            shape_mesh.v2x[i] = x + 1; shape_mesh.v2z[i] = y;     shape_mesh.v2y[i] = getXY(x + 1, y);
+            const real_t x0 = x * xspacing, x1 = (x + 1) * xspacing;
+            const real_t z0 = y * yspacing, z1 = (y + 1) * yspacing;
+
+            mesh.v0x[i] = x0; mesh.v0z[i] = z0; mesh.v0y[i] = getXY(x, y);   // swapped coordinates
+            mesh.v1x[i] = x0; mesh.v1z[i] = z1; mesh.v1y[i] = getXY(x, y + 1);
+            mesh.v2x[i] = x1; mesh.v2z[i] = z0; mesh.v2y[i] = getXY(x + 1, y);
             ++i;
 
-            shape_mesh.v0x[i] = x + 1; shape_mesh.v0z[i] = y + 1; shape_mesh.v0y[i] = getXY(x + 1, y + 1);
-            shape_mesh.v1x[i] = x + 1; shape_mesh.v1z[i] = y;     shape_mesh.v1y[i] = getXY(x + 1, y);
-            shape_mesh.v2x[i] = x;     shape_mesh.v2z[i] = y + 1; shape_mesh.v2y[i] = getXY(x, y + 1);
+            mesh.v0x[i] = x1; mesh.v0z[i] = z1; mesh.v0y[i] = getXY(x + 1, y + 1);
+            mesh.v1x[i] = x1; mesh.v1z[i] = z0; mesh.v1y[i] = getXY(x + 1, y);
+            mesh.v2x[i] = x0; mesh.v2z[i] = z1; mesh.v2y[i] = getXY(x, y + 1);
             ++i;
         }
     }
-    shape_mesh.findNormals();
-    shape_mesh.findCircumcentres();
+    mesh.findNormals();
+    mesh.findCircumcentres();
+    return mesh;
 }
 
 void SolarCollector::exportAsSTL(std::string name) const {
-    shape_mesh.exportSTL(name);
+    buildMesh().exportSTL(name);
 }
 
 void SolarCollector::exportAsBinarySTL(std::string name) const {
-    shape_mesh.exportBinarySTL(name);
+    buildMesh().exportBinarySTL(name);
 }
 
 // void SolarCollector::exportReflectionAsSTL() {
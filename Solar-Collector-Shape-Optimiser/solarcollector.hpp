@@ -2,35 +2,116 @@
 #define SOLARCOLLECTOR_HPP
 
 
+#include <array>
+
 #include <Solar-Collector-Shape-Optimiser/mesh3d.hpp>
+#include <Solar-Collector-Shape-Optimiser/mesharena.hpp>
+#include <Solar-Collector-Shape-Optimiser/shadowtable.hpp>
+#include <Solar-Collector-Shape-Optimiser/acceptancemap.hpp>
 #include <Solar-Collector-Shape-Optimiser/genome.hpp>
 
+// number of rays traced together against the obstacle; lane loops over a packet are vectorised by the compiler
+// (AVX2/AVX-512 with -march=native, plain scalar code on targets without wide enough vector units)
+// (wider packets of float geometry lose more to divergence between neighbouring rays than they gain in SIMD width)
+constexpr uint32_t RAY_PACKET_SIZE = 8;
+static_assert(RAY_PACKET_SIZE < 32, "the active lanes of a packet are a 32-bit mask");
+// packets with fewer active lanes than this are traced ray by ray
+constexpr uint32_t RAY_PACKET_MIN_ACTIVE = 3;
+
+// number of mesh triangles traced as one task of computeFitness (multiple of RAY_PACKET_SIZE)
+constexpr uint32_t FITNESS_CHUNK_SIZE = 2048;
+
+// SoA batch of rays (origins and directions), one lane per ray
+struct ray_packet {
+    alignas(64) real_t ox[RAY_PACKET_SIZE] = {};
+    alignas(64) real_t oy[RAY_PACKET_SIZE] = {};
+    alignas(64) real_t oz[RAY_PACKET_SIZE] = {};
+    alignas(64) real_t dx[RAY_PACKET_SIZE] = {};
+    alignas(64) real_t dy[RAY_PACKET_SIZE] = {};
+    alignas(64) real_t dz[RAY_PACKET_SIZE] = {};
+};
+
 class SolarCollector : public Genome { // Inherits from Genome
 public:
     uint32_t xsize;   // size of the panel
     uint32_t ysize;
     uint32_t hmax;  // maximal height (dictated by max printing height)
+    double xspacing; // distance (mm) between neighbouring heights along x - greater than 1 for coarse grids (see resampleFrom)
+    double yspacing;
+
+    // B-spline encoding (control_spacing > 0): 'dna' holds a control_xsize x control_ysize grid of heights, control_spacing
+    // mm apart, and computeMesh expands the uniform cubic B-spline surface they define into 'surface'; otherwise (0) 'dna'
+    // is the heightmap itself and 'surface' is empty
+    double control_spacing;
+    uint32_t control_xsize;
+    uint32_t control_ysize;
+    std::vector<gene_t> surface;
+    std::vector<double> surface_rows; // scratch of expandSurface (control rows blended along x), per individual like 'surface'
 
-    Mesh3d shape_mesh; // mesh calculated from 'dna' member
+    uint32_t triangle_count; // number of triangles of the shape - ex. 3x3 shape has 4 rectangles -> 8 triangles
+    shape_view shape; // normals and circumcentres calculated from the heightmap, or empty if computeFitness derives them on the fly
 
     const Mesh3d* obstacle; // pointer to obstacle to read its mesh
 
-    std::vector<triangle> reflecting; // I think it's for checking the shape of the mesh built only from triangles that reflect the ray directly onto the obstacle - it's an overkill to store all triangles, just store bools or something
+    std::vector<uint32_t> fitness_chunks; // first mesh triangle of every chunk that computeFitness schedules as a separate task
 
-    SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs);
-    SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const Genome &genome);
-    // copy, move constructors, assignments can be default
+    // bitset of mesh triangles that reflect a ray directly onto the obstacle; bit (i % 64) of word (r * reflecting_stride + i / 64)
+    // belongs to mesh triangle i and ray r, so computeFitness of an offspring can copy results of triangles it shares with a parent
+    std::vector<uint64_t> reflecting;
+    uint32_t reflecting_stride; // words per ray
+    // individuals this one was bred from (set by the caller, consumed and cleared by the next computeFitness)
+    std::array<const SolarCollector*, 2> inherited_from;
+
+    // `storage` is a MeshArena slot for the shape data; without it only the heightmap ('dna') is stored
+    // heights are genes in [0, hm], in steps of `gene_resolution` (see Genome), `xs` x `ys` of them `xsp` and `ysp` mm apart
+    // (or B-spline control points `ctrl` mm apart, if it isn't 0: `ctrl_xs` x `ctrl_ys` of them, 0 for as many as the grid
+    // needs - pass the count of the full grid to every coarser grid of the same area, their (xs-1)*xsp can round up)
+    SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const shape_view& storage = shape_view(), 
+                    const double gene_resolution = 0.0, const double xsp = 1.0, const double ysp = 1.0, const double ctrl = 0.0,
+                    const uint32_t ctrl_xs = 0, const uint32_t ctrl_ys = 0);
+    SolarCollector (const uint32_t xs, const uint32_t ys, const uint32_t hm, const Mesh3d* obs, const Genome &genome, const shape_view& storage = shape_view(),
+                    const double xsp = 1.0, const double ysp = 1.0, const double ctrl = 0.0, const uint32_t ctrl_xs = 0, const uint32_t ctrl_ys = 0);
+    // number of control points along a side of `length` mm (B-spline encoding)
+    static uint32_t controlCount(const double length, const double ctrl) { return uint32_t(std::ceil(length / ctrl)) + 3; }
+    // copy, move constructors, assignments can be default (copies share the MeshArena slot - breed in place instead)
     ~SolarCollector();
 
+    // replaces this individual with an offspring of two others, reusing all of its buffers
+    void breed(const SolarCollector &parent1, const SolarCollector &parent2, const double& crossover_bias, const double& mutation_probability, const double& mutation_range, 
+               RngStream& rng);
+
+    // heightmap (xsize x ysize) the mesh is made of
+    const gene_t* heightmap() const { return control_spacing > 0.0 ? surface.data() : dna.data(); }
+    // genes that shape the collector: the heights, or the control points (the rest of a heightmap's dna is unused)
+    uint32_t shapeGenes() const { return control_spacing > 0.0 ? control_xsize * control_ysize : xsize * ysize; }
+    // identical shapes give the same hash (unlike Genome::hashDNA, the unused genes don't count)
+    uint64_t hashShape() const;
     double getXY(const uint32_t x, const uint32_t y) const;
-    void setXY(const uint32_t x, const uint32_t y, const double val);
+    void setXY(const uint32_t x, const uint32_t y, const double val); // heightmap encoding only
     void showYourself() const;
+    // heights of this grid interpolated from another grid over the same area, ex. a coarser one
+    void resampleFrom(const SolarCollector& other);
     
     // when having a ray == (0, -1, 0) we can remove all the triangles that are not in the plane
     // so when having a ray == (x, y, z) we can transform all the coordinates so that ray becomes (0, -1, 0) and the check for intersection is faster
-    bool rayObstacleHit(const double& sourcex, const double& sourcey, const double& sourcez, const vertex& ray, bool invertRay) const;
-    void computeFitness(const std::vector<vertex>& rays);
+    bool rayObstacleHit(const double& sourcex, const double& sourcey, const double& sourcez, const vertex& ray, bool invertRay,
+                        trace_counts* counts = nullptr) const;
+    // same test for a whole packet; bit `l` of `active` enables lane `l`, bit `l` of the result is set if that lane hits
+    // (the work done is added to `counts`)
+    uint32_t rayPacketObstacleHit(const ray_packet& packet, const uint32_t active, trace_counts& counts) const;
+    void deriveGeometry(const uint32_t first, const uint32_t count, real_t* normx, real_t* normy, real_t* normz, 
+                        real_t* midpx, real_t* midpy, real_t* midpz) const;
+    bool sameTriangle(const SolarCollector& other, const uint32_t i) const;
+    uint32_t traceRange(const std::vector<vertex>& rays, const uint32_t first, const uint32_t last, 
+                        const std::array<const SolarCollector*, 2>& sources, const ShadowTable* shadows, 
+                        const AcceptanceMap* acceptance);
+    // `shadows` (built for the same rays) replaces tracing towards the source of light with a lookup,
+    // `acceptance` replaces tracing the reflected rays with an (approximate) lookup
+    void computeFitness(const std::vector<vertex>& rays, const ShadowTable* shadows = nullptr, const AcceptanceMap* acceptance = nullptr);
+    void adoptFitness(const double known_fitness, const uint64_t key);
+    void expandSurface();
     void computeMesh();
+    Mesh3d buildMesh() const;
     void exportAsSTL(std::string name) const;
     void exportAsBinarySTL(std::string name) const;
     // void exportReflectionAsSTL();
@@ -2,90 +2,470 @@
 #include <algorithm>
 #include <numeric>
 #include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
 
 #include "Solar-Collector-Shape-Optimiser/stats.hpp"
+#include "Solar-Collector-Shape-Optimiser/perfcounters.hpp"
+#include "Solar-Collector-Shape-Optimiser/trace.hpp"
 
-std::map<std::string, std::vector<stat_fields>> Stats::stats; // Definition of the static member
+namespace {
 
-void Stats::begin(const std::string& stat_name) {
-    // Create a new stat_fields object and push it into the vector.
-    // The constructor automatically captures the start time.
-    if (stats.find(stat_name) == stats.end()) {
-        // If the key doesn't exist, create a new vector for it.
-        stats[stat_name] = std::vector<stat_fields>();
+// phase of counters added while no timer runs
+constexpr stat_id NO_PHASE = STATS_MAX_TIMERS;
+
+// one timer as recorded by one thread
+struct timer_fields {
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sum_ns;
+    std::atomic<uint64_t> min_ns;
+    std::atomic<uint64_t> max_ns;
+    std::atomic<uint64_t> last_ns;
+    std::atomic<uint64_t> last_stamp; // when the last duration ended (ns of the steady clock)
+    std::atomic<uint64_t> buckets[STATS_BUCKETS];
+};
+
+// everything one thread records; only the owning thread writes (plain load + store, no locked instructions),
+// show() reads concurrently (relaxed - figures may lag by an event)
+// clear() can't reset a block under its owner (the owner's load + store would undo it), so it starts a new epoch and
+// every owner resets its own block the next time it records; until then show() skips the block
+struct thread_block {
+    std::atomic<uint64_t> epoch; // of the figures in the block
+    timer_fields timers[STATS_MAX_TIMERS];
+    std::atomic<uint64_t> counters[STATS_MAX_TIMERS + 1][STATS_MAX_COUNTERS]; // per phase (+ outside of any phase)
+    std::atomic<uint64_t> perf[STATS_MAX_TIMERS + 1][PERF_EVENT_COUNT];         // hardware events per phase
+
+    // owning thread only
+    std::chrono::steady_clock::time_point started[STATS_MAX_TIMERS];
+    stat_id outer[STATS_MAX_TIMERS]; // phase that was running when the timer began
+    bool running[STATS_MAX_TIMERS];
+    std::unique_ptr<PerfCounters> perf_counters; // opened by the first sample after Stats::enablePerfCounters
+    perf_sample perf_previous;
+
+    thread_block() : epoch(0), outer(), running(), perf_counters(), perf_previous() {
+        reset();
+    }
+
+    void reset() {
+        for (timer_fields& t : timers) {
+            t.count.store(0, std::memory_order_relaxed);
+            t.sum_ns.store(0, std::memory_order_relaxed);
+            t.min_ns.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+            t.max_ns.store(0, std::memory_order_relaxed);
+            t.last_ns.store(0, std::memory_order_relaxed);
+            t.last_stamp.store(0, std::memory_order_relaxed);
+            for (auto& bucket : t.buckets) {
+                bucket.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& phase : counters) {
+            for (auto& counter : phase) {
+                counter.store(0, std::memory_order_relaxed);
+            }
+        }
+        for (auto& phase : perf) {
+            for (auto& event : phase) {
+                event.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+};
+
+struct registry {
+    std::mutex mutex; // registration of names and thread blocks, show(), clear()
+    std::vector<std::string> timer_names;
+    std::vector<std::string> counter_names;
+    std::vector<std::unique_ptr<thread_block> > blocks; // kept after their thread exits (their figures still count)
+    std::atomic<stat_id> phase;
+    std::atomic<uint64_t> epoch; // incremented by clear()
+    std::atomic<bool> perf_enabled;
+    std::atomic<bool> perf_failed; // the kernel refused the counters (reported once)
+    uint64_t perf_vector_event;
+
+    // figures at the previous show() - rates of the last interval
+    std::vector<uint64_t> shown_sum_ns;
+    std::vector<std::vector<uint64_t> > shown_counters;
+
+    registry() : phase(NO_PHASE)
+               , epoch(0)
+               , perf_enabled(false)
+               , perf_failed(false)
+               , perf_vector_event(0)
+               , shown_sum_ns(STATS_MAX_TIMERS + 1, 0)
+               , shown_counters(STATS_MAX_TIMERS + 1, std::vector<uint64_t>(STATS_MAX_COUNTERS, 0))
+    {
+        timer_names.reserve(STATS_MAX_TIMERS); // names never move - Trace keeps pointers to them
+        // STAT_RAYS_TRACED, STAT_TRIANGLE_TESTS, STAT_AABB_REJECTS, STAT_BVH_NODES
+        counter_names = {"RaysTraced", "TriangleTests", "AabbRejects", "BvhNodes"};
+    }
+};
+
+registry& state() {
+    static registry instance;
+    return instance;
+}
+
+thread_block& localBlock() {
+    thread_local thread_block* block = nullptr;
+    registry& reg = state();
+    if (block == nullptr) {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.blocks.push_back(std::make_unique<thread_block>());
+        block = reg.blocks.back().get();
+        block->epoch.store(reg.epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+    // figures recorded before the last clear() (see thread_block)
+    const uint64_t epoch = reg.epoch.load(std::memory_order_acquire);
+    if (block->epoch.load(std::memory_order_relaxed) != epoch) {
+        block->reset();
+        block->epoch.store(epoch, std::memory_order_release);
+    }
+    return *block;
+}
+
+// the owner is the only writer, so a read-modify-write doesn't have to be atomic
+inline void bump(std::atomic<uint64_t>& value, const uint64_t count) {
+    value.store(value.load(std::memory_order_relaxed) + count, std::memory_order_relaxed);
+}
+
+// adds the hardware events since the previous sample of this thread to the current phase
+void samplePerf(thread_block& block) {
+    registry& reg = state();
+    if (!reg.perf_enabled.load(std::memory_order_acquire)) {
+        return;
+    }
+    if (!block.perf_counters) {
+        block.perf_counters = std::make_unique<PerfCounters>(reg.perf_vector_event);
+        if (!block.perf_counters->available() && !reg.perf_failed.exchange(true)) {
+            std::cerr << "Warning: no hardware counters in Stats - " << block.perf_counters->error << std::endl;
+        }
+        block.perf_counters->read(block.perf_previous);
+        return;
+    }
+
+    perf_sample now;
+    if (!block.perf_counters->read(now)) {
+        return;
     }
-    stats[stat_name].push_back(stat_fields());
+    auto& perf = block.perf[reg.phase.load(std::memory_order_relaxed)];
+    for (uint32_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+        bump(perf[event], now.values[event] - std::min(now.values[event], block.perf_previous.values[event]));
+    }
+    block.perf_previous = now;
+}
+
+uint64_t nanoseconds(const std::chrono::steady_clock::time_point& time) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
 }
 
-void Stats::end(const std::string& stat_name) {
-    // Check if the vector for the given stat_name exists and is not empty.
-    if (stats.find(stat_name) != stats.end() && !stats[stat_name].empty()) {
-        // Get the last (most recent) stat_fields object from the vector.
-        stat_fields& current_stat = stats[stat_name].back();
+// 0-3 ns have a bucket each, then every power of two is split into 4 buckets
+uint32_t bucketOf(const uint64_t ns) {
+    if (ns < 4) {
+        return ns;
+    }
+    const uint32_t exponent = 63 - std::countl_zero(ns);
+    return (exponent - 1) * 4 + ((ns >> (exponent - 2)) & 3);
+}
 
-        // Update the finish time and calculate the duration.
-        current_stat.finish = std::chrono::high_resolution_clock::now();
-        current_stat.delta = current_stat.finish - current_stat.start;
+// duration in the unit that keeps it readable, ex. 12.3ms
+std::string duration(const double ns) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+    if (ns >= 1e9) {
+        text << ns * 1e-9 << "s";
+    } else if (ns >= 1e6) {
+        text << ns * 1e-6 << "ms";
+    } else if (ns >= 1e3) {
+        text << ns * 1e-3 << "us";
     } else {
-        // Handle the case where begin() was not called or the vector is empty.
-        std::cerr << "Warning: Stats::end() called for '" << stat_name
-                  << "' without a corresponding Stats::begin() or vector is empty." << std::endl;
+        text << ns << "ns";
+    }
+    return text.str();
+}
+
+// count in M/k (small ones, ex. of the FitnessCache, as they are)
+std::string amount(const double count) {
+    std::ostringstream text;
+    text << std::fixed << std::setprecision(1);
+    if (count >= 1e6) {
+        text << count * 1e-6 << "M";
+    } else if (count >= 1e3) {
+        text << count * 1e-3 << "k";
+    } else {
+        text << count;
+    }
+    return text.str();
+}
+
+// middle of a bucket in ns
+double bucketValue(const uint32_t bucket) {
+    if (bucket < 4) {
+        return bucket;
+    }
+    const uint32_t exponent = bucket / 4 + 1;
+    const double width = std::ldexp(1.0, exponent - 2);
+    return (4 + bucket % 4) * width + width / 2;
+}
+
+stat_id registerName(std::vector<std::string>& names, const std::string& name, const uint32_t max, const std::string& kind) {
+    std::lock_guard<std::mutex> lock(state().mutex);
+    const auto it = std::find(names.begin(), names.end(), name);
+    if (it != names.end()) {
+        return it - names.begin();
     }
+    if (names.size() == max) {
+        throw std::runtime_error("Too many " + kind + "s (max " + std::to_string(max) + "): " + name);
+    }
+    names.push_back(name);
+    return names.size() - 1;
+}
+
+} // namespace
+
+stat_id Stats::timer(const std::string& name) {
+    return registerName(state().timer_names, name, STATS_MAX_TIMERS, "timer");
+}
+
+stat_id Stats::counter(const std::string& name) {
+    return registerName(state().counter_names, name, STATS_MAX_COUNTERS, "counter");
+}
+
+void Stats::begin(const stat_id timer_id) {
+    thread_block& block = localBlock();
+    samplePerf(block);
+    block.running[timer_id] = true;
+    block.outer[timer_id] = state().phase.exchange(timer_id, std::memory_order_relaxed);
+    block.started[timer_id] = std::chrono::steady_clock::now();
+}
+
+void Stats::end(const stat_id timer_id) {
+    const auto finish = std::chrono::steady_clock::now();
+    thread_block& block = localBlock();
+    if (!block.running[timer_id]) {
+        // Handle the case where begin() was not called.
+        std::cerr << "Warning: Stats::end() called for '" << state().timer_names[timer_id]
+                  << "' without a corresponding Stats::begin()." << std::endl;
+        return;
+    }
+    block.running[timer_id] = false;
+    samplePerf(block);
+    state().phase.store(block.outer[timer_id], std::memory_order_relaxed);
+
+    const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - block.started[timer_id]).count();
+    timer_fields& t = block.timers[timer_id];
+    bump(t.count, 1);
+    bump(t.sum_ns, ns);
+    t.min_ns.store(std::min(t.min_ns.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+    t.max_ns.store(std::max(t.max_ns.load(std::memory_order_relaxed), ns), std::memory_order_relaxed);
+    t.last_ns.store(ns, std::memory_order_relaxed);
+    t.last_stamp.store(nanoseconds(finish), std::memory_order_relaxed);
+    bump(t.buckets[bucketOf(ns)], 1);
+
+    // phases are spans of the timeline as well
+    if (Trace::enabled()) {
+        Trace::record(state().timer_names[timer_id].c_str(), block.started[timer_id], nullptr, 0);
+    }
+}
+
+void Stats::add(const stat_id counter_id, const uint64_t count) {
+    bump(localBlock().counters[state().phase.load(std::memory_order_relaxed)][counter_id], count);
+}
+
+void Stats::add(const trace_counts& counts) {
+    thread_block& block = localBlock();
+    auto& counters = block.counters[state().phase.load(std::memory_order_relaxed)];
+    bump(counters[STAT_RAYS_TRACED], counts.rays);
+    bump(counters[STAT_TRIANGLE_TESTS], counts.triangle_tests);
+    bump(counters[STAT_AABB_REJECTS], counts.aabb_rejects);
+    bump(counters[STAT_BVH_NODES], counts.bvh_nodes);
+    samplePerf(block);
+}
+
+void Stats::enablePerfCounters(const uint64_t vector_event) {
+    registry& reg = state();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.perf_vector_event = vector_event;
+    }
+    reg.perf_enabled.store(true, std::memory_order_release);
+    samplePerf(localBlock()); // fails (and warns) right away if the kernel doesn't allow it
 }
+
 void Stats::show() {
+    registry& reg = state();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    // merge the blocks of all threads (the cost depends on the number of threads and ids, not on the length of the run)
+    struct merged_timer {
+        uint64_t count = 0, sum_ns = 0, min_ns = std::numeric_limits<uint64_t>::max(), max_ns = 0, last_ns = 0, last_stamp = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(STATS_BUCKETS, 0);
+    };
+    std::vector<merged_timer> timers(reg.timer_names.size());
+    std::vector<std::vector<uint64_t> > counters(STATS_MAX_TIMERS + 1, std::vector<uint64_t>(reg.counter_names.size(), 0));
+    // hardware events per phase and thread (block)
+    std::vector<std::vector<perf_sample> > perf(STATS_MAX_TIMERS + 1, std::vector<perf_sample>(reg.blocks.size()));
+
+    const uint64_t epoch = reg.epoch.load(std::memory_order_relaxed);
+    for (size_t thread = 0; thread < reg.blocks.size(); ++thread) {
+        const auto& block = reg.blocks[thread];
+        if (block->epoch.load(std::memory_order_acquire) != epoch) {
+            continue; // not recorded anything since clear()
+        }
+        for (size_t id = 0; id < timers.size(); ++id) {
+            const timer_fields& t = block->timers[id];
+            merged_timer& m = timers[id];
+            const uint64_t count = t.count.load(std::memory_order_relaxed);
+            if (count == 0) {
+                continue;
+            }
+            m.count += count;
+            m.sum_ns += t.sum_ns.load(std::memory_order_relaxed);
+            m.min_ns = std::min(m.min_ns, t.min_ns.load(std::memory_order_relaxed));
+            m.max_ns = std::max(m.max_ns, t.max_ns.load(std::memory_order_relaxed));
+            const uint64_t stamp = t.last_stamp.load(std::memory_order_relaxed);
+            if (stamp >= m.last_stamp) {
+                m.last_stamp = stamp;
+                m.last_ns = t.last_ns.load(std::memory_order_relaxed);
+            }
+            for (uint32_t b = 0; b < STATS_BUCKETS; ++b) {
+                m.buckets[b] += t.buckets[b].load(std::memory_order_relaxed);
+            }
+        }
+        for (uint32_t phase = 0; phase <= STATS_MAX_TIMERS; ++phase) {
+            for (size_t id = 0; id < reg.counter_names.size(); ++id) {
+                counters[phase][id] += block->counters[phase][id].load(std::memory_order_relaxed);
+            }
+            for (uint32_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+                perf[phase][thread].values[event] = block->perf[phase][event].load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    auto percentile = [](const merged_timer& m, const double p) {
+        const uint64_t rank = std::max<uint64_t>(1, uint64_t(std::ceil(p * m.count)));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < STATS_BUCKETS; ++b) {
+            seen += m.buckets[b];
+            if (seen >= rank) {
+                // the bucket's middle, within the exactly known range
+                return std::clamp(bucketValue(b), double(m.min_ns), double(m.max_ns));
+            }
+        }
+        return double(m.max_ns);
+    };
+
+    // counters of a phase: totals and rates over the phase's whole time and over its time since the previous show()
+    auto showCounters = [&](const uint32_t phase, const uint64_t sum_ns) {
+        for (size_t id = 0; id < reg.counter_names.size(); ++id) {
+            const uint64_t total = counters[phase][id];
+            if (total == 0) {
+                continue;
+            }
+            const uint64_t delta = total - reg.shown_counters[phase][id];
+            const uint64_t delta_ns = sum_ns - reg.shown_sum_ns[phase];
+            std::cerr << "    " << reg.counter_names[id] << ":\t" << amount(total) << " (total)";
+            if (sum_ns > 0) {
+                std::cerr << "; " << amount(total / (sum_ns * 1e-9)) << "/s (avg)";
+            }
+            if (delta_ns > 0) {
+                std::cerr << "; " << amount(delta / (delta_ns * 1e-9)) << "/s (last)";
+            }
+            std::cerr << std::endl;
+            reg.shown_counters[phase][id] = total;
+        }
+        reg.shown_sum_ns[phase] = sum_ns;
+
+        // hardware events: compute (IPC) vs memory (LLC misses) vs branch bound, in total and per thread
+        auto showPerf = [](const perf_sample& s) {
+            const double instructions = std::max<uint64_t>(s.values[PERF_INSTRUCTIONS], 1);
+            std::cerr << s.values[PERF_CYCLES] / 1e6 << "M cycles; "
+                      << std::setprecision(2) << s.values[PERF_INSTRUCTIONS] / std::max(1.0, double(s.values[PERF_CYCLES])) << " IPC; "
+                      << s.values[PERF_LLC_MISSES] * 1e3 / instructions << " LLC misses/1k instr; "
+                      << s.values[PERF_BRANCH_MISSES] * 1e3 / instructions << " branch misses/1k instr";
+            if (s.values[PERF_VECTOR_INSTRUCTIONS] > 0) {
+                std::cerr << "; " << s.values[PERF_VECTOR_INSTRUCTIONS] * 1e2 / instructions << "% vector instr";
+            }
+            std::cerr << std::setprecision(1) << std::endl;
+        };
+        perf_sample total;
+        uint32_t threads = 0;
+        for (const perf_sample& s : perf[phase]) {
+            for (uint32_t event = 0; event < PERF_EVENT_COUNT; ++event) {
+                total.values[event] += s.values[event];
+            }
+            threads += s.values[PERF_CYCLES] > 0;
+        }
+        if (threads == 0) {
+            return;
+        }
+        std::cerr << "    Hardware:\t";
+        showPerf(total);
+        for (size_t thread = 0; threads > 1 && thread < perf[phase].size(); ++thread) {
+            if (perf[phase][thread].values[PERF_CYCLES] > 0) {
+                std::cerr << "      thread " << thread << ":\t";
+                showPerf(perf[phase][thread]);
+            }
+        }
+    };
+
     std::cerr << std::fixed << std::setprecision(1); // Set precision for output
     std::cerr << "---------------------------------- Statistics ----------------------------------" << std::endl;
 
     // First, calculate the total time across all statistics.
-    double total_all_time = 0.0;
-    for (const auto& [stat_name, history] : stats) {
-        total_all_time += std::accumulate(history.begin(), history.end(), 0.0,
-            [](const double& sum, const stat_fields& s) {
-                return sum + s.delta.count();
-            });
-    }
-
-    for (auto& [stat_name, history] : stats) {
-        std::cerr << stat_name << ":\t";
-
-        // Calculate statistics
-        if (!history.empty()) {
-            // last time
-            const double last_time = history.back().delta.count();
-
-            // min max time
-            const auto [min_it, max_it] = std::minmax_element(history.begin(), history.end(), 
-                [](const stat_fields& a, const stat_fields& b) {
-                    return a.delta.count() < b.delta.count();
-                });
-            const double min_time = min_it->delta.count();
-            const double max_time = max_it->delta.count();
-
-            // total time
-            const double total_time = std::accumulate(history.begin(), history.end(), 0.0, 
-                [](const double& sum, const stat_fields& sf) {
-                    return sum + sf.delta.count();
-                }); 
-
-            // avg time
-            const double avg_time = total_time / history.size();
-
-            // Calculate percentage of total time.
-            const double percentage = (total_all_time > 0.0) ? (total_time / total_all_time) * 100.0 : 0.0;
-
-            std::cerr << last_time << "s (last); " 
-                      << avg_time << "s (avg); " 
-                      << min_time << "s (min); " 
-                      << max_time << "s (max); " 
-                      << total_time/60.0 << "m (total); "
-                      << percentage << "% (total); " << std::endl;
+    const double total_all_time = std::accumulate(timers.begin(), timers.end(), 0.0,
+        [](const double sum, const merged_timer& m) {
+            return sum + m.sum_ns * 1e-9;
+        });
 
+    // in order of names (as they're numbered)
+    std::vector<stat_id> order(timers.size());
+    std::iota(order.begin(), order.end(), 0u);
+    std::sort(order.begin(), order.end(), [&](const stat_id a, const stat_id b) { return reg.timer_names[a] < reg.timer_names[b]; });
+
+    for (const stat_id id : order) {
+        const merged_timer& m = timers[id];
+        if (m.count == 0) {
+            continue;
         }
+        const double total_time = m.sum_ns * 1e-9;
+        // Calculate percentage of total time.
+        const double percentage = (total_all_time > 0.0) ? (total_time / total_all_time) * 100.0 : 0.0;
+
+        std::cerr << reg.timer_names[id] << ":\t"
+                  << duration(m.last_ns) << " (last); "
+                  << duration(double(m.sum_ns) / m.count) << " (avg); "
+                  << duration(m.min_ns) << " (min); "
+                  << duration(percentile(m, 0.5)) << " (p50); "
+                  << duration(percentile(m, 0.9)) << " (p90); "
+                  << duration(percentile(m, 0.99)) << " (p99); "
+                  << duration(m.max_ns) << " (max); "
+                  << duration(m.sum_ns) << " (total); "
+                  << percentage << "% (total); " << std::endl;
+        showCounters(id, m.sum_ns);
+    }
+    if (std::any_of(counters[NO_PHASE].begin(), counters[NO_PHASE].end(), [](const uint64_t total) { return total > 0; })
+        || std::any_of(perf[NO_PHASE].begin(), perf[NO_PHASE].end(), [](const perf_sample& s) { return s.values[PERF_CYCLES] > 0; })) {
+        std::cerr << "Outside of timers:" << std::endl;
+        showCounters(NO_PHASE, 0);
     }
 
     std::cerr << "--------------------------------------------------------------------------------" << std::endl;
 }
 
 void Stats::clear() {
-    stats.clear();
-}
\ No newline at end of file
+    registry& reg = state();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.epoch.fetch_add(1, std::memory_order_release); // (each owner resets its own block, see thread_block)
+    std::fill(reg.shown_sum_ns.begin(), reg.shown_sum_ns.end(), 0);
+    for (auto& phase : reg.shown_counters) {
+        std::fill(phase.begin(), phase.end(), 0);
+    }
+}
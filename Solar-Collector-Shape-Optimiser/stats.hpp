@@ -1,37 +1,64 @@
 #ifndef STATS_HPP
 #define STATS_HPP
 
-#include <chrono>
+#include <cstdint>
 #include <string>
-#include <map>
-#include <vector>
 
-struct stat_fields {
+// index of a timer or a counter, returned once by Stats::timer / Stats::counter and passed to the recording methods
+typedef uint32_t stat_id;
 
-    const std::chrono::time_point<std::chrono::high_resolution_clock> start;
-    std::chrono::time_point<std::chrono::high_resolution_clock> finish;
-    std::chrono::duration<double> delta;
+constexpr uint32_t STATS_MAX_TIMERS = 16;
+constexpr uint32_t STATS_MAX_COUNTERS = 16;
+// durations are histogrammed in buckets 4 per power of two of nanoseconds (percentiles within ~10%)
+constexpr uint32_t STATS_BUCKETS = 256;
 
-    stat_fields() : start(std::chrono::high_resolution_clock::now())
-                  , finish(std::chrono::high_resolution_clock::now())
-                  , delta(finish - start) 
-    {};
+// counters of the ray tracer, registered before any other counter
+constexpr stat_id STAT_RAYS_TRACED = 0;    // rays tested against the obstacle (lanes of packets included)
+constexpr stat_id STAT_TRIANGLE_TESTS = 1; // obstacle triangles tested (against a whole packet at once in packet traversal)
+constexpr stat_id STAT_AABB_REJECTS = 2;   // BVH nodes whose box the ray (every ray of a packet) misses
+constexpr stat_id STAT_BVH_NODES = 3;      // BVH nodes visited
+
+// events of one or more traversals - collected in local variables by the tracer and added to Stats in one go
+struct trace_counts {
+    uint64_t rays = 0;
+    uint64_t triangle_tests = 0;
+    uint64_t aabb_rejects = 0;
+    uint64_t bvh_nodes = 0;
+
+    trace_counts& operator+=(const trace_counts& other) {
+        rays += other.rays;
+        triangle_tests += other.triangle_tests;
+        aabb_rejects += other.aabb_rejects;
+        bvh_nodes += other.bvh_nodes;
+        return *this;
+    }
 };
 
+// Timers (phases of the program) and event counters, safe to record from any thread.
+// Every thread records into its own block (single writer, no locks or read-modify-write atomics), which show() merges;
+// a timer keeps count, sum, min, max, last and a histogram of its durations, so memory doesn't grow with the run.
+// Counters are attributed to the timer running on the main thread when they are added (the current phase), so show()
+// can report ex. rays/second of the fitness computation.
+// Optionally every thread also counts hardware events (see PerfCounters): the events since a thread's previous sample
+// go to the current phase whenever it begins/ends a timer or adds trace counts (once per traced range of the fitness).
+// While Trace is enabled, every phase is also a span of the timeline.
 class Stats {
-    // Static members to hold the statistics
-    static std::map<std::string, std::vector<stat_fields> > stats; // Store key-value pairs
-
 public:
-    // Static methods to time and show statistics
-    // time related
-    static void begin(const std::string& stat_name);
-    static void end(const std::string& stat_name);
-    // generation stats
+    // ids of a timer/counter with this name (registered on the first call - do it once, outside of hot loops)
+    static stat_id timer(const std::string& name);
+    static stat_id counter(const std::string& name);
+
+    // time related (phases begin and end on the main thread, and nest)
+    static void begin(const stat_id timer_id);
+    static void end(const stat_id timer_id);
+    // events
+    static void add(const stat_id counter_id, const uint64_t count);
+    static void add(const trace_counts& counts); // also samples the hardware counters
+    // hardware counters (from now on, in every thread that records something; `vector_event` see PerfCounters)
+    static void enablePerfCounters(const uint64_t vector_event);
     // other
     static void show();
     static void clear();
-
 };
 
-#endif // STATS_HPP
\ No newline at end of file
+#endif // STATS_HPP
@@ -0,0 +1,178 @@
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <algorithm>
+
+#include <Solar-Collector-Shape-Optimiser/trace.hpp>
+#include <Solar-Collector-Shape-Optimiser/filewriter.hpp>
+
+namespace {
+
+// a trace_event in the ring; fields are relaxed atomics, as snapshot() may read a slot while its owner overwrites it
+struct trace_slot {
+    std::atomic<const char*> name;
+    std::atomic<const char*> arg_name;
+    std::atomic<int64_t> arg;
+    std::atomic<uint64_t> start_ns;
+    std::atomic<uint64_t> duration_ns;
+
+    trace_slot() : name(nullptr), arg_name(nullptr), arg(0), start_ns(0), duration_ns(0) {}
+};
+
+// spans of one thread; the owner writes a slot and then publishes it by advancing `head`
+struct trace_ring {
+    uint32_t tid;
+    std::string name; // guarded by the registry's mutex
+    std::vector<trace_slot> events;
+    std::atomic<uint64_t> head; // number of spans ever recorded
+
+    trace_ring(const uint32_t tid, const std::string& name, const uint32_t capacity)
+        : tid(tid), name(name), events(capacity), head(0) {}
+};
+
+struct registry {
+    std::mutex mutex; // registration of rings and names, snapshots
+    std::vector<std::unique_ptr<trace_ring> > rings; // kept after their thread exits
+    std::atomic<bool> enabled;
+    uint32_t capacity;
+    std::chrono::steady_clock::time_point epoch;
+
+    registry() : enabled(false), capacity(0) {}
+};
+
+registry& state() {
+    static registry instance;
+    return instance;
+}
+
+thread_local trace_ring* local_ring = nullptr;
+thread_local std::string local_name; // set by nameThread before the thread's ring exists
+
+trace_ring& localRing() {
+    if (local_ring == nullptr) {
+        registry& reg = state();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.rings.push_back(std::make_unique<trace_ring>(reg.rings.size(), local_name, reg.capacity));
+        local_ring = reg.rings.back().get();
+    }
+    return *local_ring;
+}
+
+// microseconds with 3 decimals, as Chrome expects them
+std::string microseconds(const uint64_t ns) {
+    const std::string fraction = std::to_string(ns % 1000);
+    return std::to_string(ns / 1000) + "." + std::string(3 - fraction.size(), '0') + fraction;
+}
+
+std::string quoted(const std::string& text) {
+    std::string ret = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\')
+            ret += '\\';
+        ret += c;
+    }
+    return ret + "\"";
+}
+
+} // namespace
+
+void Trace::enable(const uint32_t capacity) {
+    registry& reg = state();
+    {
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.capacity = std::max(capacity, 1u);
+        reg.epoch = std::chrono::steady_clock::now();
+    }
+    reg.enabled.store(true, std::memory_order_release);
+}
+
+bool Trace::enabled() {
+    return state().enabled.load(std::memory_order_acquire);
+}
+
+void Trace::nameThread(const std::string& name) {
+    local_name = name;
+    if (local_ring != nullptr) {
+        std::lock_guard<std::mutex> lock(state().mutex);
+        local_ring->name = name;
+    }
+}
+
+void Trace::record(const char* name, const std::chrono::steady_clock::time_point& start, const char* arg_name, const int64_t arg) {
+    const auto finish = std::chrono::steady_clock::now();
+    const registry& reg = state();
+    trace_ring& ring = localRing();
+
+    const uint64_t head = ring.head.load(std::memory_order_relaxed);
+    trace_slot& event = ring.events[head % ring.events.size()];
+    const uint64_t start_ns = start > reg.epoch ? std::chrono::duration_cast<std::chrono::nanoseconds>(start - reg.epoch).count() : 0;
+    const uint64_t duration_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(finish - std::max(start, reg.epoch)).count();
+    // a snapshot that reads any of the new fields also sees `head` (pairs with the fence in snapshot)
+    std::atomic_thread_fence(std::memory_order_release);
+    event.name.store(name, std::memory_order_relaxed);
+    event.arg_name.store(arg_name, std::memory_order_relaxed);
+    event.arg.store(arg, std::memory_order_relaxed);
+    event.start_ns.store(start_ns, std::memory_order_relaxed);
+    event.duration_ns.store(duration_ns, std::memory_order_relaxed);
+    ring.head.store(head + 1, std::memory_order_release);
+}
+
+std::vector<trace_thread> Trace::snapshot() {
+    registry& reg = state();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+
+    std::vector<trace_thread> threads;
+    for (const auto& ring : reg.rings) {
+        trace_thread thread{ring->tid, ring->name.empty() ? "worker " + std::to_string(ring->tid) : ring->name, {}};
+
+        // copy the published spans, then drop the ones the owner may have overwritten meanwhile (seqlock style) - while
+        // head is `now`, the owner may be writing slot `now % capacity`, which still holds span `now - capacity`
+        const uint64_t capacity = ring->events.size();
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t first = head > capacity ? head - capacity : 0;
+        for (uint64_t i = first; i < head; ++i) {
+            const trace_slot& slot = ring->events[i % capacity];
+            thread.events.push_back({slot.name.load(std::memory_order_relaxed), slot.arg_name.load(std::memory_order_relaxed),
+                                     slot.arg.load(std::memory_order_relaxed), slot.start_ns.load(std::memory_order_relaxed),
+                                     slot.duration_ns.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t now = ring->head.load(std::memory_order_relaxed);
+        const uint64_t valid = now + 1 > capacity ? now + 1 - capacity : 0;
+        if (valid > first) {
+            thread.events.erase(thread.events.begin(), thread.events.begin() + std::min(valid - first, head - first));
+        }
+        threads.push_back(std::move(thread));
+    }
+    return threads;
+}
+
+void Trace::writeChromeJson(const std::vector<trace_thread>& threads, const std::string& filename) {
+    FileWriter file(filename);
+    file.write("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    bool first = true;
+    auto separator = [&]() {
+        if (!first)
+            file.write(",\n");
+        first = false;
+    };
+
+    for (const trace_thread& thread : threads) {
+        const std::string ids = "\"pid\":1,\"tid\":" + std::to_string(thread.tid);
+        separator();
+        file.write("{\"name\":\"thread_name\",\"ph\":\"M\"," + ids + ",\"args\":{\"name\":" + quoted(thread.name) + "}}");
+
+        for (const trace_event& event : thread.events) {
+            separator();
+            std::string line = "{\"name\":\"" + std::string(event.name) + "\",\"ph\":\"X\"," + ids
+                             + ",\"ts\":" + microseconds(event.start_ns) + ",\"dur\":" + microseconds(event.duration_ns);
+            if (event.arg_name != nullptr) {
+                line += ",\"args\":{\"" + std::string(event.arg_name) + "\":" + std::to_string(event.arg) + "}";
+            }
+            file.write(line + "}");
+        }
+    }
+    file.write("\n]}\n");
+    file.close();
+}
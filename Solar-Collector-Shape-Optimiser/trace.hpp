@@ -0,0 +1,67 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+
+// a finished span of work on one thread
+struct trace_event {
+    const char* name;      // string literal
+    const char* arg_name;  // string literal naming `arg` (ex. "slot"), nullptr for none
+    int64_t arg;
+    uint64_t start_ns;     // since Trace::enable
+    uint64_t duration_ns;
+};
+
+// spans recorded by one thread, oldest first
+struct trace_thread {
+    uint32_t tid;
+    std::string name;
+    std::vector<trace_event> events;
+};
+
+// Timeline of what every thread worked on, for chrome://tracing or Perfetto (ui.perfetto.dev).
+// Every thread records its spans into its own ring buffer (single writer, no locks) keeping the most recent ones, so
+// tracing runs in constant memory; snapshot() copies them and writeChromeJson() turns a copy into a trace file.
+// Until enable() is called, a TraceSpan only checks a flag.
+class Trace {
+public:
+    // starts recording, keeping the last `capacity` spans of every thread
+    static void enable(const uint32_t capacity);
+    static bool enabled();
+    // name of the calling thread in the timeline (threads without one show as "worker <tid>")
+    static void nameThread(const std::string& name);
+    // records a span from `start` until now on the calling thread
+    static void record(const char* name, const std::chrono::steady_clock::time_point& start, const char* arg_name, const int64_t arg);
+
+    // copy of the spans of every thread (can be taken while other threads record)
+    static std::vector<trace_thread> snapshot();
+    // Chrome trace-event JSON of a snapshot (complete events, times in microseconds)
+    static void writeChromeJson(const std::vector<trace_thread>& threads, const std::string& filename);
+};
+
+// records the span of its own lifetime
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* arg_name = nullptr, const int64_t arg = 0)
+        : name(name), arg_name(arg_name), arg(arg), active(Trace::enabled())
+        , start(active ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+    ~TraceSpan() {
+        if (active) {
+            Trace::record(name, start, arg_name, arg);
+        }
+    }
+
+private:
+    const char* name;
+    const char* arg_name;
+    const int64_t arg;
+    const bool active;
+    const std::chrono::steady_clock::time_point start;
+};
+
+#endif // TRACE_HPP